@@ -23,6 +23,7 @@ struct {
 	__u64 ALIGN cpus[1];
 	struct jailhouse_memory ALIGN mem_regions[1];
 	__u8 ALIGN pio_bitmap[0x2000];
+	struct jailhouse_cpuid_mask ALIGN cpuid_masks[1];
 } ALIGN config = {
 	.cell = {
 		.name = "Tiny Demo",
@@ -33,6 +34,7 @@ struct {
 		.num_irq_lines = 0,
 		.pio_bitmap_size = ARRAY_SIZE(config.pio_bitmap),
 		.num_pci_devices = 0,
+		.num_cpuid_masks = ARRAY_SIZE(config.cpuid_masks),
 	},
 
 	.cpus = {
@@ -62,4 +64,12 @@ struct {
 		[0xe000/8 ... 0xe007/8] = 0, /* OXPCIe952 serial2 */
 		[0xe008/8 ... 0xffff/8] = -1,
 	},
+
+	.cpuid_masks = {
+		/* hide VMX */ {
+			.function = 0x00000001,
+			.index = JAILHOUSE_CPUID_NO_INDEX,
+			.clear[JAILHOUSE_CPUID_ECX] = 1 << 5,
+		},
+	},
 };
@@ -24,6 +24,7 @@
 #include <linux/reboot.h>
 #include <linux/vmalloc.h>
 #include <linux/io.h>
+#include <linux/delay.h>
 #include <asm/smp.h>
 #include <asm/cacheflush.h>
 
@@ -74,8 +75,12 @@ static const struct sysfs_ops cell_sysfs_ops = {
 
 #define JAILHOUSE_FW_NAME	"jailhouse.bin"
 
+/* interval for polling cells that have not yet answered a shutdown request */
+#define SHUTDOWN_POLL_MS	10
+
 struct cell {
 	struct kobject kobj;
+	struct kobject stats_kobj;
 	struct list_head entry;
 	unsigned int id;
 	cpumask_t cpus_assigned;
@@ -170,20 +175,251 @@ static ssize_t cpus_failed_show(struct kobject *kobj,
 	return written;
 }
 
+static ssize_t cell_info_show(struct kobject *kobj, char *buffer,
+			      unsigned int type)
+{
+	struct cell *cell = container_of(kobj, struct cell, kobj);
+	int val;
+
+	val = jailhouse_call2(JAILHOUSE_HC_CELL_GET_INFO, cell->id, type);
+	if (val < 0)
+		return val;
+	return sprintf(buffer, "%d\n", val);
+}
+
+static ssize_t page_budget_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buffer)
+{
+	return cell_info_show(kobj, buffer, JAILHOUSE_CELL_INFO_PAGE_BUDGET);
+}
+
+static ssize_t page_budget_used_show(struct kobject *kobj,
+				     struct kobj_attribute *attr, char *buffer)
+{
+	return cell_info_show(kobj, buffer,
+			      JAILHOUSE_CELL_INFO_PAGE_BUDGET_USED);
+}
+
+static ssize_t pages_used_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buffer)
+{
+	return cell_info_show(kobj, buffer, JAILHOUSE_CELL_INFO_PAGES_USED);
+}
+
 static struct kobj_attribute cell_id_attr = __ATTR_RO(id);
 static struct kobj_attribute cell_state_attr = __ATTR_RO(state);
 static struct kobj_attribute cell_cpus_assigned_attr =
 	__ATTR_RO(cpus_assigned);
 static struct kobj_attribute cell_cpus_failed_attr = __ATTR_RO(cpus_failed);
+static struct kobj_attribute cell_page_budget_attr = __ATTR_RO(page_budget);
+static struct kobj_attribute cell_page_budget_used_attr =
+	__ATTR_RO(page_budget_used);
+static struct kobj_attribute cell_pages_used_attr = __ATTR_RO(pages_used);
 
 static struct attribute *cell_attrs[] = {
 	&cell_id_attr.attr,
 	&cell_state_attr.attr,
 	&cell_cpus_assigned_attr.attr,
 	&cell_cpus_failed_attr.attr,
+	&cell_page_budget_attr.attr,
+	&cell_page_budget_used_attr.attr,
+	&cell_pages_used_attr.attr,
 	NULL,
 };
 
+struct cell_stat_attr {
+	struct kobj_attribute kattr;
+	unsigned int code;
+};
+
+static ssize_t cell_stat_show(struct kobject *kobj,
+			      struct kobj_attribute *attr, char *buffer)
+{
+	struct cell_stat_attr *stat_attr =
+		container_of(attr, struct cell_stat_attr, kattr);
+	struct cell *cell = container_of(kobj, struct cell, stats_kobj);
+	struct jailhouse_cell_stats *stats;
+	ssize_t written = 0;
+	int err;
+
+	/* kmalloc keeps the buffer within a page as the hypervisor requires */
+	stats = kmalloc(sizeof(*stats), GFP_KERNEL | GFP_DMA);
+	if (!stats)
+		return -ENOMEM;
+
+	err = jailhouse_call2(JAILHOUSE_HC_CELL_GET_STAT, cell->id,
+			      __pa(stats));
+	if (!err)
+		written = sprintf(buffer, "%llu\n",
+				  (unsigned long long)
+				  stats->counters[stat_attr->code]);
+
+	kfree(stats);
+
+	return err ? err : written;
+}
+
+#define CELL_STAT_ATTR(_name, _code)					\
+	static struct cell_stat_attr cell_stat_##_name##_attr = {	\
+		.kattr = __ATTR(_name, S_IRUGO, cell_stat_show, NULL),	\
+		.code = _code,						\
+	}
+
+/*
+ * Collects the VM exit latencies of all CPUs of the cell into sum, unless it
+ * is NULL, and optionally resets the histograms of the CPUs.
+ */
+static int cell_latency_collect(struct cell *cell,
+				struct jailhouse_cpu_latency *sum,
+				unsigned int flags)
+{
+	struct jailhouse_cpu_latency *latency;
+	unsigned int cpu, class, bucket;
+	int err = 0;
+
+	/* kmalloc keeps the buffer within a page as the hypervisor requires */
+	latency = kmalloc(sizeof(*latency), GFP_KERNEL | GFP_DMA);
+	if (!latency)
+		return -ENOMEM;
+
+	if (sum)
+		memset(sum, 0, sizeof(*sum));
+
+	for_each_cpu_mask(cpu, cell->cpus_assigned) {
+		err = jailhouse_call3(JAILHOUSE_HC_CPU_GET_LATENCY, cpu,
+				      __pa(latency), flags);
+		if (err || !sum)
+			continue;
+
+		for (class = 0; class < JAILHOUSE_NUM_LATENCY_CLASSES;
+		     class++) {
+			if (latency->max_cycles[class] > sum->max_cycles[class])
+				sum->max_cycles[class] =
+					latency->max_cycles[class];
+			for (bucket = 0; bucket < JAILHOUSE_LATENCY_BUCKETS;
+			     bucket++)
+				sum->buckets[class][bucket] +=
+					latency->buckets[class][bucket];
+		}
+	}
+
+	kfree(latency);
+
+	return err;
+}
+
+static ssize_t cell_latency_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buffer)
+{
+	struct cell_stat_attr *stat_attr =
+		container_of(attr, struct cell_stat_attr, kattr);
+	struct cell *cell = container_of(kobj, struct cell, stats_kobj);
+	struct jailhouse_cpu_latency *sum;
+	unsigned int class = stat_attr->code;
+	unsigned int bucket;
+	ssize_t written;
+	int err;
+
+	sum = kmalloc(sizeof(*sum), GFP_KERNEL);
+	if (!sum)
+		return -ENOMEM;
+
+	err = cell_latency_collect(cell, sum, 0);
+	if (err) {
+		kfree(sum);
+		return err;
+	}
+
+	written = sprintf(buffer, "%llu",
+			  (unsigned long long)sum->max_cycles[class]);
+	for (bucket = 0; bucket < JAILHOUSE_LATENCY_BUCKETS; bucket++)
+		written += sprintf(buffer + written, " %u",
+				   sum->buckets[class][bucket]);
+	written += sprintf(buffer + written, "\n");
+
+	kfree(sum);
+
+	return written;
+}
+
+static ssize_t latency_reset_store(struct kobject *kobj,
+				   struct kobj_attribute *attr,
+				   const char *buffer, size_t count)
+{
+	struct cell *cell = container_of(kobj, struct cell, stats_kobj);
+	int err;
+
+	err = cell_latency_collect(cell, NULL, JAILHOUSE_CPU_LATENCY_RESET);
+
+	return err ? err : count;
+}
+
+#define CELL_LATENCY_ATTR(_name, _class)				\
+	static struct cell_stat_attr cell_latency_##_name##_attr = {	\
+		.kattr = __ATTR(latency_##_name, S_IRUGO,		\
+				cell_latency_show, NULL),		\
+		.code = _class,						\
+	}
+
+CELL_STAT_ATTR(vmexits_total, JAILHOUSE_CPU_STAT_VMEXITS_TOTAL);
+CELL_STAT_ATTR(vmexits_management, JAILHOUSE_CPU_STAT_VMEXITS_MANAGEMENT);
+CELL_STAT_ATTR(vmexits_hypercall, JAILHOUSE_CPU_STAT_VMEXITS_HYPERCALL);
+CELL_STAT_ATTR(vmexits_cpuid, JAILHOUSE_CPU_STAT_VMEXITS_CPUID);
+CELL_STAT_ATTR(vmexits_cr, JAILHOUSE_CPU_STAT_VMEXITS_CR);
+CELL_STAT_ATTR(vmexits_msr, JAILHOUSE_CPU_STAT_VMEXITS_MSR);
+CELL_STAT_ATTR(vmexits_x2apic_icr, JAILHOUSE_CPU_STAT_VMEXITS_X2APIC_ICR);
+CELL_STAT_ATTR(vmexits_x2apic, JAILHOUSE_CPU_STAT_VMEXITS_X2APIC);
+CELL_STAT_ATTR(vmexits_xapic, JAILHOUSE_CPU_STAT_VMEXITS_XAPIC);
+CELL_STAT_ATTR(vmexits_xapic_icr, JAILHOUSE_CPU_STAT_VMEXITS_XAPIC_ICR);
+CELL_STAT_ATTR(vmexits_xsetbv, JAILHOUSE_CPU_STAT_VMEXITS_XSETBV);
+
+CELL_LATENCY_ATTR(management, JAILHOUSE_LATENCY_MANAGEMENT);
+CELL_LATENCY_ATTR(hypercall, JAILHOUSE_LATENCY_HYPERCALL);
+CELL_LATENCY_ATTR(cpuid, JAILHOUSE_LATENCY_CPUID);
+CELL_LATENCY_ATTR(cr, JAILHOUSE_LATENCY_CR);
+CELL_LATENCY_ATTR(msr, JAILHOUSE_LATENCY_MSR);
+CELL_LATENCY_ATTR(xapic, JAILHOUSE_LATENCY_XAPIC);
+CELL_LATENCY_ATTR(xsetbv, JAILHOUSE_LATENCY_XSETBV);
+CELL_LATENCY_ATTR(other, JAILHOUSE_LATENCY_OTHER);
+
+static struct kobj_attribute cell_latency_reset_attr =
+	__ATTR(latency_reset, S_IWUSR, NULL, latency_reset_store);
+
+static struct attribute *cell_stats_attrs[] = {
+	&cell_stat_vmexits_total_attr.kattr.attr,
+	&cell_stat_vmexits_management_attr.kattr.attr,
+	&cell_stat_vmexits_hypercall_attr.kattr.attr,
+	&cell_stat_vmexits_cpuid_attr.kattr.attr,
+	&cell_stat_vmexits_cr_attr.kattr.attr,
+	&cell_stat_vmexits_msr_attr.kattr.attr,
+	&cell_stat_vmexits_x2apic_icr_attr.kattr.attr,
+	&cell_stat_vmexits_x2apic_attr.kattr.attr,
+	&cell_stat_vmexits_xapic_attr.kattr.attr,
+	&cell_stat_vmexits_xapic_icr_attr.kattr.attr,
+	&cell_stat_vmexits_xsetbv_attr.kattr.attr,
+	&cell_latency_management_attr.kattr.attr,
+	&cell_latency_hypercall_attr.kattr.attr,
+	&cell_latency_cpuid_attr.kattr.attr,
+	&cell_latency_cr_attr.kattr.attr,
+	&cell_latency_msr_attr.kattr.attr,
+	&cell_latency_xapic_attr.kattr.attr,
+	&cell_latency_xsetbv_attr.kattr.attr,
+	&cell_latency_other_attr.kattr.attr,
+	&cell_latency_reset_attr.attr,
+	NULL,
+};
+
+static void cell_stats_kobj_release(struct kobject *kobj)
+{
+	/* embedded into struct cell, freed along with the cell kobject */
+}
+
+static struct kobj_type cell_stats_type = {
+	.release = cell_stats_kobj_release,
+	.sysfs_ops = &kobj_sysfs_ops,
+	.default_attrs = cell_stats_attrs,
+};
+
 static void cell_kobj_release(struct kobject *kobj)
 {
 	struct cell *cell = container_of(kobj, struct cell, kobj);
@@ -217,6 +453,14 @@ static struct cell *create_cell(const struct jailhouse_cell_desc *cell_desc)
 		return ERR_PTR(err);
 	}
 
+	err = kobject_init_and_add(&cell->stats_kobj, &cell_stats_type,
+				   &cell->kobj, "statistics");
+	if (err) {
+		kobject_put(&cell->stats_kobj);
+		kobject_put(&cell->kobj);
+		return ERR_PTR(err);
+	}
+
 	return cell;
 }
 
@@ -224,6 +468,7 @@ static void register_cell(struct cell *cell)
 {
 	list_add_tail(&cell->entry, &cells);
 	kobject_uevent(&cell->kobj, KOBJ_ADD);
+	kobject_uevent(&cell->stats_kobj, KOBJ_ADD);
 }
 
 static struct cell *find_cell(struct jailhouse_cell_desc *cell_desc)
@@ -239,6 +484,7 @@ static struct cell *find_cell(struct jailhouse_cell_desc *cell_desc)
 static void delete_cell(struct cell *cell)
 {
 	list_del(&cell->entry);
+	kobject_put(&cell->stats_kobj);
 	kobject_put(&cell->kobj);
 }
 
@@ -431,18 +677,22 @@ static int jailhouse_disable(void)
 		goto unlock_out;
 	}
 
-	error_code = 0;
+	do {
+		error_code = 0;
 
-	preempt_disable();
+		preempt_disable();
 
-	atomic_set(&call_done, 0);
-	on_each_cpu(leave_hypervisor, NULL, 0);
-	while (atomic_read(&call_done) != num_online_cpus())
-		cpu_relax();
+		atomic_set(&call_done, 0);
+		on_each_cpu(leave_hypervisor, NULL, 0);
+		while (atomic_read(&call_done) != num_online_cpus())
+			cpu_relax();
 
-	preempt_enable();
+		preempt_enable();
 
-	err = error_code;
+		err = error_code;
+		if (err == -EAGAIN && msleep_interruptible(SHUTDOWN_POLL_MS))
+			err = -EINTR;
+	} while (err == -EAGAIN);
 	if (err)
 		goto unlock_out;
 
@@ -601,6 +851,24 @@ error_cpu_online:
 	goto unlock_out;
 }
 
+/*
+ * Issues a hypercall that shuts a cell down. The hypervisor returns -EAGAIN
+ * until the cell answered the shutdown request, so retry in that case.
+ */
+static int jailhouse_cell_call(unsigned int code, unsigned int id,
+			       unsigned long arg)
+{
+	int err;
+
+	while (1) {
+		err = jailhouse_call2(code, id, arg);
+		if (err != -EAGAIN)
+			return err;
+		if (msleep_interruptible(SHUTDOWN_POLL_MS))
+			return -EINTR;
+	}
+}
+
 static int jailhouse_cell_destroy(const char __user *arg)
 {
 	struct jailhouse_cell_desc *config;
@@ -640,20 +908,22 @@ static int jailhouse_cell_destroy(const char __user *arg)
 		goto unlock_out;
 	}
 
-	err = jailhouse_call1(JAILHOUSE_HC_CELL_DESTROY, cell->id);
+	err = jailhouse_cell_call(JAILHOUSE_HC_CELL_DESTROY, cell->id, 0);
 	if (err)
 		goto unlock_out;
 
-	delete_cell(cell);
-
-	for_each_cell_cpu(cpu, config)
+	/* CPUs may have been moved since creation, use the current set */
+	for_each_cpu_mask(cpu, cell->cpus_assigned) {
 		if (cpu_isset(cpu, offlined_cpus)) {
 			if (cpu_up(cpu) != 0)
 				pr_err("Jailhouse: failed to bring CPU %d "
 				       "back online\n", cpu);
 			cpu_clear(cpu, offlined_cpus);
-			cpu_set(cpu, root_cell->cpus_assigned);
 		}
+		cpu_set(cpu, root_cell->cpus_assigned);
+	}
+
+	delete_cell(cell);
 
 	pr_info("Destroyed Jailhouse cell \"%s\"\n", config->name);
 
@@ -666,6 +936,224 @@ kfree_config_out:
 	return err;
 }
 
+static int jailhouse_cell_start(struct jailhouse_cell_start __user *arg)
+{
+	struct jailhouse_cell_start cell_params;
+	struct jailhouse_cell_desc *config;
+	unsigned long flags = 0;
+	struct cell *cell;
+	int err;
+
+	if (copy_from_user(&cell_params, arg, sizeof(cell_params)))
+		return -EFAULT;
+
+	if (cell_params.flags & ~JAILHOUSE_CELL_RESTORE_IMAGES)
+		return -EINVAL;
+	if (cell_params.flags & JAILHOUSE_CELL_RESTORE_IMAGES)
+		flags |= JAILHOUSE_CELL_START_RESTORE;
+
+	config = kmalloc(cell_params.config_size, GFP_KERNEL | GFP_DMA);
+	if (!config)
+		return -ENOMEM;
+
+	if (copy_from_user(config,
+			   (void *)(unsigned long)cell_params.config_address,
+			   cell_params.config_size)) {
+		err = -EFAULT;
+		goto kfree_config_out;
+	}
+	config->name[JAILHOUSE_CELL_NAME_MAXLEN] = 0;
+
+	if (mutex_lock_interruptible(&lock) != 0) {
+		err = -EINTR;
+		goto kfree_config_out;
+	}
+
+	if (!enabled) {
+		err = -EINVAL;
+		goto unlock_out;
+	}
+
+	cell = find_cell(config);
+	if (!cell) {
+		err = -ENOENT;
+		goto unlock_out;
+	}
+
+	err = jailhouse_cell_call(JAILHOUSE_HC_CELL_START, cell->id, flags);
+	if (err)
+		goto unlock_out;
+
+	pr_info("Started Jailhouse cell \"%s\"\n", config->name);
+
+unlock_out:
+	mutex_unlock(&lock);
+
+kfree_config_out:
+	kfree(config);
+
+	return err;
+}
+
+static int jailhouse_cpu_move(struct jailhouse_cpu_move __user *arg)
+{
+	struct jailhouse_cell_desc *config = NULL;
+	struct jailhouse_cpu_move params;
+	struct cell *source, *target;
+	bool offlined = false;
+	unsigned int cpu;
+	int err;
+
+	if (copy_from_user(&params, arg, sizeof(params)))
+		return -EFAULT;
+
+	cpu = params.cpu;
+	if (cpu >= nr_cpu_ids || !cpu_possible(cpu))
+		return -EINVAL;
+
+	if (params.config_address) {
+		config = kmalloc(params.config_size, GFP_KERNEL | GFP_DMA);
+		if (!config)
+			return -ENOMEM;
+
+		if (copy_from_user(config,
+				   (void *)(unsigned long)params.config_address,
+				   params.config_size)) {
+			err = -EFAULT;
+			goto kfree_config_out;
+		}
+		config->name[JAILHOUSE_CELL_NAME_MAXLEN] = 0;
+	}
+
+	if (mutex_lock_interruptible(&lock) != 0) {
+		err = -EINTR;
+		goto kfree_config_out;
+	}
+
+	if (!enabled) {
+		err = -EINVAL;
+		goto unlock_out;
+	}
+
+	target = config ? find_cell(config) : root_cell;
+	if (!target) {
+		err = -ENOENT;
+		goto unlock_out;
+	}
+
+	err = -EINVAL;
+	list_for_each_entry(source, &cells, entry)
+		if (cpu_isset(cpu, source->cpus_assigned)) {
+			err = 0;
+			break;
+		}
+	if (err || source == target)
+		goto unlock_out;
+
+	if (source == root_cell && cpu_online(cpu)) {
+		err = cpu_down(cpu);
+		if (err)
+			goto unlock_out;
+		cpu_set(cpu, offlined_cpus);
+		offlined = true;
+	}
+
+	err = jailhouse_call2(JAILHOUSE_HC_CPU_MOVE, cpu, target->id);
+	if (err) {
+		if (offlined && cpu_up(cpu) == 0)
+			cpu_clear(cpu, offlined_cpus);
+		goto unlock_out;
+	}
+
+	cpu_clear(cpu, source->cpus_assigned);
+	cpu_set(cpu, target->cpus_assigned);
+
+	if (target == root_cell && cpu_isset(cpu, offlined_cpus)) {
+		if (cpu_up(cpu) != 0)
+			pr_err("Jailhouse: failed to bring CPU %d "
+			       "back online\n", cpu);
+		cpu_clear(cpu, offlined_cpus);
+	}
+
+	pr_info("Moved CPU %d to Jailhouse cell \"%s\"\n", cpu,
+		kobject_name(&target->kobj));
+
+unlock_out:
+	mutex_unlock(&lock);
+
+kfree_config_out:
+	kfree(config);
+
+	return err;
+}
+
+static int jailhouse_cell_mem(struct jailhouse_cell_mem __user *arg,
+			      unsigned int hypercall)
+{
+	struct jailhouse_cell_desc *config;
+	struct jailhouse_memory *region;
+	struct cell *cell;
+	__u64 config_address;
+	__u32 config_size;
+	int err;
+
+	if (get_user(config_address, &arg->config_address) ||
+	    get_user(config_size, &arg->config_size))
+		return -EFAULT;
+
+	/* the hypervisor reads the region from physical memory */
+	region = kmalloc(sizeof(*region), GFP_KERNEL | GFP_DMA);
+	if (!region)
+		return -ENOMEM;
+
+	if (copy_from_user(region, &arg->region, sizeof(*region))) {
+		err = -EFAULT;
+		goto kfree_region_out;
+	}
+
+	config = kmalloc(config_size, GFP_KERNEL | GFP_DMA);
+	if (!config) {
+		err = -ENOMEM;
+		goto kfree_region_out;
+	}
+
+	if (copy_from_user(config, (void *)(unsigned long)config_address,
+			   config_size)) {
+		err = -EFAULT;
+		goto kfree_config_out;
+	}
+	config->name[JAILHOUSE_CELL_NAME_MAXLEN] = 0;
+
+	if (mutex_lock_interruptible(&lock) != 0) {
+		err = -EINTR;
+		goto kfree_config_out;
+	}
+
+	if (!enabled) {
+		err = -EINVAL;
+		goto unlock_out;
+	}
+
+	cell = find_cell(config);
+	if (!cell) {
+		err = -ENOENT;
+		goto unlock_out;
+	}
+
+	err = jailhouse_call2(hypercall, cell->id, __pa(region));
+
+unlock_out:
+	mutex_unlock(&lock);
+
+kfree_config_out:
+	kfree(config);
+
+kfree_region_out:
+	kfree(region);
+
+	return err;
+}
+
 static long jailhouse_ioctl(struct file *file, unsigned int ioctl,
 			    unsigned long arg)
 {
@@ -686,6 +1174,24 @@ static long jailhouse_ioctl(struct file *file, unsigned int ioctl,
 	case JAILHOUSE_CELL_DESTROY:
 		err = jailhouse_cell_destroy((const char __user *)arg);
 		break;
+	case JAILHOUSE_CELL_START:
+		err = jailhouse_cell_start(
+			(struct jailhouse_cell_start __user *)arg);
+		break;
+	case JAILHOUSE_CPU_MOVE:
+		err = jailhouse_cpu_move(
+			(struct jailhouse_cpu_move __user *)arg);
+		break;
+	case JAILHOUSE_CELL_MEM_ATTACH:
+		err = jailhouse_cell_mem(
+			(struct jailhouse_cell_mem __user *)arg,
+			JAILHOUSE_HC_CELL_MEM_ATTACH);
+		break;
+	case JAILHOUSE_CELL_MEM_DETACH:
+		err = jailhouse_cell_mem(
+			(struct jailhouse_cell_mem __user *)arg,
+			JAILHOUSE_HC_CELL_MEM_DETACH);
+		break;
 	default:
 		err = -EINVAL;
 		break;
@@ -774,9 +1280,100 @@ static ssize_t remap_pool_used_show(struct device *dev,
 	return info_show(dev, buffer, JAILHOUSE_INFO_REMAP_POOL_USED);
 }
 
+static ssize_t mem_pool_peak_used_show(struct device *dev,
+				       struct device_attribute *attr,
+				       char *buffer)
+{
+	return info_show(dev, buffer, JAILHOUSE_INFO_MEM_POOL_PEAK_USED);
+}
+
+static ssize_t mem_pool_largest_free_show(struct device *dev,
+					  struct device_attribute *attr,
+					  char *buffer)
+{
+	return info_show(dev, buffer, JAILHOUSE_INFO_MEM_POOL_LARGEST_FREE);
+}
+
+static ssize_t mem_pool_alloc_failures_show(struct device *dev,
+					    struct device_attribute *attr,
+					    char *buffer)
+{
+	return info_show(dev, buffer, JAILHOUSE_INFO_MEM_POOL_ALLOC_FAILURES);
+}
+
+static ssize_t mem_pool_used_hv_pt_show(struct device *dev,
+					struct device_attribute *attr,
+					char *buffer)
+{
+	return info_show(dev, buffer, JAILHOUSE_INFO_MEM_POOL_USED_HV_PT);
+}
+
+static ssize_t mem_pool_used_cell_pt_show(struct device *dev,
+					  struct device_attribute *attr,
+					  char *buffer)
+{
+	return info_show(dev, buffer, JAILHOUSE_INFO_MEM_POOL_USED_CELL_PT);
+}
+
+static ssize_t mem_pool_used_iommu_pt_show(struct device *dev,
+					   struct device_attribute *attr,
+					   char *buffer)
+{
+	return info_show(dev, buffer, JAILHOUSE_INFO_MEM_POOL_USED_IOMMU_PT);
+}
+
+static ssize_t mem_pool_used_cells_show(struct device *dev,
+					struct device_attribute *attr,
+					char *buffer)
+{
+	return info_show(dev, buffer, JAILHOUSE_INFO_MEM_POOL_USED_CELLS);
+}
+
+static ssize_t mem_pool_used_cpu_sets_show(struct device *dev,
+					   struct device_attribute *attr,
+					   char *buffer)
+{
+	return info_show(dev, buffer, JAILHOUSE_INFO_MEM_POOL_USED_CPU_SETS);
+}
+
+static ssize_t mem_pool_free_blocks_show(struct device *dev,
+					 struct device_attribute *attr,
+					 char *buffer)
+{
+	unsigned int order;
+	ssize_t len = 0;
+	int val;
+
+	if (mutex_lock_interruptible(&lock) != 0)
+		return -EINTR;
+
+	/* one count of free blocks per order, until the hypervisor refuses */
+	for (order = 0; enabled; order++) {
+		val = jailhouse_call1(JAILHOUSE_HC_HYPERVISOR_GET_INFO,
+				JAILHOUSE_INFO_MEM_POOL_FREE_BLOCKS(order));
+		if (val < 0)
+			break;
+		len += scnprintf(buffer + len, PAGE_SIZE - len, "%s%d",
+				 order > 0 ? " " : "", val);
+	}
+	len += scnprintf(buffer + len, PAGE_SIZE - len, "\n");
+
+	mutex_unlock(&lock);
+	return len;
+}
+
 static DEVICE_ATTR_RO(enabled);
 static DEVICE_ATTR_RO(mem_pool_size);
 static DEVICE_ATTR_RO(mem_pool_used);
+static DEVICE_ATTR_RO(mem_pool_peak_used);
+static DEVICE_ATTR_RO(mem_pool_largest_free);
+static DEVICE_ATTR_RO(mem_pool_alloc_failures);
+static DEVICE_ATTR_RO(mem_pool_used_hv_pt);
+static DEVICE_ATTR_RO(mem_pool_used_cell_pt);
+static DEVICE_ATTR_RO(mem_pool_used_iommu_pt);
+static DEVICE_ATTR_RO(mem_pool_used_cells);
+static DEVICE_ATTR_RO(mem_pool_used_cpu_sets);
+static DEVICE_ATTR_RO(mem_pool_free_blocks);
 static DEVICE_ATTR_RO(remap_pool_size);
 static DEVICE_ATTR_RO(remap_pool_used);
 
@@ -784,6 +1381,15 @@ static struct attribute *jailhouse_sysfs_entries[] = {
 	&dev_attr_enabled.attr,
 	&dev_attr_mem_pool_size.attr,
 	&dev_attr_mem_pool_used.attr,
+	&dev_attr_mem_pool_peak_used.attr,
+	&dev_attr_mem_pool_largest_free.attr,
+	&dev_attr_mem_pool_alloc_failures.attr,
+	&dev_attr_mem_pool_used_hv_pt.attr,
+	&dev_attr_mem_pool_used_cell_pt.attr,
+	&dev_attr_mem_pool_used_iommu_pt.attr,
+	&dev_attr_mem_pool_used_cells.attr,
+	&dev_attr_mem_pool_used_cpu_sets.attr,
+	&dev_attr_mem_pool_free_blocks.attr,
 	&dev_attr_remap_pool_size.attr,
 	&dev_attr_remap_pool_used.attr,
 	NULL
@@ -14,7 +14,7 @@
 #define _JAILHOUSE_ASM_CELL_H
 
 #include <asm/types.h>
-#include <asm/paging.h>
+#include <jailhouse/paging.h>
 
 #include <jailhouse/cell-config.h>
 #include <jailhouse/hypercall.h>
@@ -24,10 +24,31 @@ struct cell {
 	unsigned int data_pages;
 	struct jailhouse_cell_desc *config;
 
+	/* memory pool pages reserved for page tables of the cell */
+	struct page_budget page_budget;
+
 	struct cpu_set *cpu_set;
 	struct cpu_set small_cpu_set;
 
-	struct cell *next;
+	/* memory regions sorted by physical address, see control.c */
+	struct mem_index_entry *mem_index;
+	unsigned int mem_index_entries;
+	unsigned int mem_index_capacity;
+
+	/* regions attached at runtime, up to a page of them */
+	struct jailhouse_memory *attached_mem;
+	unsigned int num_attached_mem;
+
+	/* next cell in the same bucket of the name hash */
+	struct cell *name_next;
+
+	/* copy of the snapshot regions taken at creation, see control.c */
+	void *snapshot;
+	unsigned long snapshot_pages;
+
+	/* state of the shutdown request and its TSC deadline, see control.c */
+	unsigned int shutdown_request;
+	unsigned long shutdown_deadline;
 
 	union {
 		struct jailhouse_comm_region comm_region;
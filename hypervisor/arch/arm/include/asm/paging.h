@@ -41,10 +41,23 @@
 
 typedef unsigned long *pt_entry_t;
 
+static inline void arch_tlb_flush_all(void)
+{
+}
+
 static inline void arch_tlb_flush_page(unsigned long addr)
 {
 }
 
+static inline void clear_page(void *addr)
+{
+	unsigned long *word = addr;
+	unsigned int n;
+
+	for (n = 0; n < PAGE_SIZE / sizeof(unsigned long); n++)
+		word[n] = 0;
+}
+
 static inline void flush_cache(void *addr, long size)
 {
 }
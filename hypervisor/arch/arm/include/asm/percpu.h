@@ -25,6 +25,7 @@
 
 #ifndef __ASSEMBLY__
 
+#include <jailhouse/paging.h>
 #include <asm/cell.h>
 
 struct per_cpu {
@@ -49,6 +50,14 @@ struct per_cpu {
 	bool shutdown_cpu;
 	int shutdown_state;
 	bool failed;
+
+	/** Statistics counters, cleared when the CPU changes its cell. */
+	u64 stats[JAILHOUSE_NUM_CPU_STATS];
+	/** VM exit latency histograms, reset by the CPU itself on request. */
+	struct jailhouse_cpu_latency latency;
+	volatile bool latency_reset;
+
+	struct guest_tlb guest_tlb;
 } __attribute__((aligned(PAGE_SIZE)));
 
 static inline struct per_cpu *per_cpu(unsigned int cpu)
@@ -26,6 +26,11 @@ static inline void memory_barrier(void)
 {
 }
 
+static inline unsigned long get_cycles(void)
+{
+	return 0;
+}
+
 #endif /* !__ASSEMBLY__ */
 
 #endif /* !_JAILHOUSE_ASM_PROCESSOR_H */
@@ -0,0 +1,18 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2013
+ *
+ * Authors:
+ *  Jan Kiszka <jan.kiszka@siemens.com>
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef _JAILHOUSE_ASM_STRING_H
+#define _JAILHOUSE_ASM_STRING_H
+
+/* ARM uses the generic, word-wise implementations of lib.c */
+
+#endif /* !_JAILHOUSE_ASM_STRING_H */
@@ -49,8 +49,19 @@ void arch_resume_cpu(unsigned int cpu_id) {}
 void arch_reset_cpu(unsigned int cpu_id) {}
 void arch_park_cpu(unsigned int cpu_id) {}
 void arch_shutdown_cpu(unsigned int cpu_id) {}
+unsigned long arch_cell_page_budget(const struct jailhouse_cell_desc *config)
+{ return 0; }
+unsigned long arch_mem_region_page_budget(const struct jailhouse_memory *mem)
+{ return 0; }
+unsigned long arch_root_cell_remap_pages(unsigned int num_regions)
+{ return 0; }
 int arch_cell_create(struct per_cpu *cpu_data, struct cell *new_cell)
 { return -ENOSYS; }
+int arch_cell_commit(struct per_cpu *cpu_data, struct cell *new_cell)
+{ return -ENOSYS; }
+void arch_cell_release(struct per_cpu *cpu_data, struct cell *new_cell) {}
+void arch_flush_cell_caches(struct per_cpu *cpu_data, struct cell *cell) {}
+void arch_cell_cpus_changed(struct cell *cell) {}
 int arch_map_memory_region(struct cell *cell,
 			   const struct jailhouse_memory *mem)
 { return -ENOSYS; }
@@ -58,7 +69,6 @@ int arch_unmap_memory_region(struct cell *cell,
 			     const struct jailhouse_memory *mem)
 { return -ENOSYS; }
 void arch_cell_destroy(struct per_cpu *cpu_data, struct cell *new_cell) {}
-void *memcpy(void *dest, const void *src, unsigned long n) { return NULL; }
 void arch_dbg_write(const char *msg) {}
 void arch_shutdown(void) {}
 unsigned long arch_page_map_gphys2phys(struct per_cpu *cpu_data,
@@ -125,7 +125,7 @@ int apic_init(void)
 		apic_ops.send_ipi = send_x2apic_ipi;
 		using_x2apic = true;
 	} else if (apicbase & APIC_BASE_EN) {
-		xapic_page = page_alloc(&remap_pool, 1);
+		xapic_page = page_alloc(&remap_pool, 1, PAGE_USAGE_OTHER);
 		if (!xapic_page)
 			return -ENOMEM;
 		err = page_map_create(&hv_paging_structs, XAPIC_BASE,
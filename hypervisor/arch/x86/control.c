@@ -11,6 +11,7 @@
  */
 
 #include <jailhouse/control.h>
+#include <jailhouse/paging.h>
 #include <jailhouse/printk.h>
 #include <jailhouse/processor.h>
 #include <asm/apic.h>
@@ -35,26 +36,400 @@ static void flush_root_cell_cpu_caches(struct per_cpu *cpu_data)
 
 	for_each_cpu_except(cpu, root_cell.cpu_set, cpu_data->cpu_id)
 		per_cpu(cpu)->flush_caches = true;
+
+	/* the caller's guest translations may refer to remapped memory */
+	page_map_guest_tlb_flush(cpu_data);
 }
 
-int arch_cell_create(struct per_cpu *cpu_data, struct cell *cell)
+/* all cell CPUs (except cpu_data) have to be stopped */
+void arch_flush_cell_caches(struct per_cpu *cpu_data, struct cell *cell)
+{
+	unsigned int cpu;
+
+	for_each_cpu_except(cpu, cell->cpu_set, cpu_data->cpu_id)
+		per_cpu(cpu)->flush_caches = true;
+
+	if (cell == cpu_data->cell) {
+		vmx_invept();
+		page_map_guest_tlb_flush(cpu_data);
+	}
+
+	vtd_cell_flush_caches(cell);
+}
+
+/*
+ * Upper bound of the page table pages that mapping the region into a 4-level
+ * x86-64 style hierarchy takes, assuming only 2M pages where the alignment
+ * permits them.
+ */
+static unsigned long region_table_pages(const struct jailhouse_memory *mem)
+{
+	unsigned long start = mem->virt_start;
+	unsigned long end = mem->virt_start + mem->size - 1;
+	unsigned long page_tables;
+
+	if (mem->size == 0)
+		return 0;
+
+	/* 2M pages leave page tables only for unaligned head and tail */
+	page_tables = (end >> 21) - (start >> 21) + 1;
+	if (((mem->phys_start ^ mem->virt_start) & ((1UL << 21) - 1)) == 0 &&
+	    page_tables > 2)
+		page_tables = 2;
+
+	return page_tables + (end >> 30) - (start >> 30) + 1 +
+		(end >> 39) - (start >> 39) + 1;
+}
+
+unsigned long arch_cell_page_budget(const struct jailhouse_cell_desc *config)
+{
+	const struct jailhouse_memory *mem =
+		jailhouse_cell_mem_regions(config);
+	/* root table and tables for the APIC access page */
+	unsigned long pages = 1 + 3;
+	unsigned int n;
+
+	for (n = 0; n < config->num_memory_regions; n++, mem++)
+		pages += region_table_pages(mem);
+
+	/* EPT and VT-d are built from the same regions */
+	return pages * 2;
+}
+
+unsigned long arch_mem_region_page_budget(const struct jailhouse_memory *mem)
+{
+	return region_table_pages(mem) * 2;
+}
+
+unsigned long arch_root_cell_remap_pages(unsigned int num_regions)
+{
+	/*
+	 * Unmapping a region may split a 1G and a 2M page at both of its
+	 * ends, in EPT and VT-d.
+	 */
+	return num_regions * 2 * 2 * 2;
+}
+
+/* target cpu has to be stopped */
+static void x86_start_cpu_work(unsigned int cpu_id,
+			       int (*work)(struct per_cpu *cpu_data,
+					   struct cell *cell),
+			       struct cell *cell)
+{
+	struct per_cpu *target_data = per_cpu(cpu_id);
+
+	target_data->work = work;
+	target_data->work_cell = cell;
+	memory_barrier();
+	target_data->work_pending = true;
+}
+
+static int x86_wait_cpu_work(unsigned int cpu_id)
+{
+	struct per_cpu *target_data = per_cpu(cpu_id);
+
+	while (target_data->work_pending)
+		cpu_relax();
+	return target_data->work_result;
+}
+
+/* Page table structure of a new cell, see arch_cell_create. */
+struct cell_pt {
+	struct paging_structures *pg_structs;
+	enum page_map_coherent coherent;
+	/** Only regions with all of these flags are mapped. */
+	u32 mem_flags;
+	/** Range covered by one root table entry, or 0 if the structure can
+	 * only be built as a whole. */
+	unsigned long root_span;
+	int (*map_range)(struct cell *cell,
+			 const struct paging_structures *pg_structs,
+			 const struct jailhouse_memory *mem);
+};
+
+static void cell_pt_get(struct cell *cell, struct cell_pt *pts)
+{
+	pts[0] = (struct cell_pt) {
+		.pg_structs = &cell->vmx.ept_structs,
+		.coherent = PAGE_MAP_NON_COHERENT,
+		.mem_flags = 0,
+		.root_span = vmx_root_entry_span(),
+		.map_range = vmx_map_memory_range,
+	};
+	pts[1] = (struct cell_pt) {
+		.pg_structs = &cell->vtd.pg_structs,
+		.coherent = PAGE_MAP_COHERENT,
+		.mem_flags = JAILHOUSE_MEM_DMA,
+		.root_span = vtd_root_entry_span(),
+		.map_range = vtd_map_memory_range,
+	};
+}
+
+static bool cell_pt_maps(const struct cell_pt *pt,
+			 const struct jailhouse_memory *mem)
+{
+	return mem->size > 0 && (mem->flags & pt->mem_flags) == pt->mem_flags;
+}
+
+/*
+ * Returns the start of the first root table entry at or after virt that
+ * covers a region mapped into the structure, or ~0UL if there is none.
+ */
+static unsigned long cell_pt_next_slot(struct cell *cell,
+				       const struct cell_pt *pt,
+				       unsigned long virt)
+{
+	const struct jailhouse_memory *mem =
+		jailhouse_cell_mem_regions(cell->config);
+	unsigned long slot, next = ~0UL;
+	unsigned int n;
+
+	for (n = 0; n < cell->config->num_memory_regions; n++, mem++) {
+		if (!cell_pt_maps(pt, mem) ||
+		    mem->virt_start + mem->size <= virt)
+			continue;
+		slot = mem->virt_start > virt ? mem->virt_start : virt;
+		slot &= ~(pt->root_span - 1);
+		if (slot < next)
+			next = slot;
+	}
+	return next;
+}
+
+/* Maps the parts of the cell's regions that fall into [start, end). */
+static int cell_pt_map(struct cell *cell, const struct cell_pt *pt,
+		       const struct paging_structures *pg_structs,
+		       unsigned long start, unsigned long end)
+{
+	const struct jailhouse_memory *mem =
+		jailhouse_cell_mem_regions(cell->config);
+	struct jailhouse_memory part;
+	unsigned int n;
+	int err;
+
+	for (n = 0; n < cell->config->num_memory_regions; n++, mem++) {
+		if (!cell_pt_maps(pt, mem) || mem->virt_start >= end ||
+		    mem->virt_start + mem->size <= start)
+			continue;
+
+		part = *mem;
+		if (part.virt_start < start) {
+			part.phys_start += start - part.virt_start;
+			part.size -= start - part.virt_start;
+			part.virt_start = start;
+		}
+		if (part.virt_start + part.size > end)
+			part.size = end - part.virt_start;
+
+		err = pt->map_range(cell, pg_structs, &part);
+		if (err)
+			return err;
+	}
+	return 0;
+}
+
+/*
+ * Creates the tables below all root table entries that will be used, so that
+ * the entries are not modified while the tables are populated in parallel.
+ */
+static int cell_pt_prepare(struct cell *cell, const struct cell_pt *pts)
 {
+	const struct cell_pt *pt;
+	unsigned int type;
+	unsigned long slot;
+
+	for (type = 0, pt = pts; type < NUM_CELL_PT_TYPES; type++, pt++) {
+		if (!pt->pg_structs->root_table || pt->root_span == 0)
+			continue;
+		for (slot = cell_pt_next_slot(cell, pt, 0); slot != ~0UL;
+		     slot = cell_pt_next_slot(cell, pt, slot + pt->root_span))
+			if (!page_map_root_subtable(pt->pg_structs, slot,
+						    pt->coherent))
+				return -ENOMEM;
+	}
+	return 0;
+}
+
+/*
+ * Builds this CPU's share of the page tables of a new cell. Each root table
+ * entry is a unit of its own, the units are distributed round-robin over the
+ * calling CPU and the CPUs of the cell.
+ */
+static int cell_pt_build(struct per_cpu *cpu_data, struct cell *cell)
+{
+	unsigned int workers = 1, index = 0, unit = 0, type, cpu;
+	struct cell_pt pts[NUM_CELL_PT_TYPES], *pt;
+	struct paging_structures sub_structs;
+	unsigned long slot;
 	int err;
 
+	for_each_cpu(cpu, cell->cpu_set) {
+		if (cpu == cpu_data->cpu_id)
+			index = workers;
+		workers++;
+	}
+
+	cell_pt_get(cell, pts);
+	for (type = 0, pt = pts; type < NUM_CELL_PT_TYPES; type++, pt++) {
+		if (!pt->pg_structs->root_table)
+			continue;
+		sub_structs = *pt->pg_structs;
+		sub_structs.cache = &cpu_data->pt_cache[type];
+
+		if (pt->root_span == 0) {
+			if (unit++ % workers != index)
+				continue;
+			err = cell_pt_map(cell, pt, &sub_structs, 0, ~0UL);
+			if (err)
+				return err;
+			continue;
+		}
+
+		sub_structs.root_paging++;
+		for (slot = cell_pt_next_slot(cell, pt, 0); slot != ~0UL;
+		     slot = cell_pt_next_slot(cell, pt, slot + pt->root_span)) {
+			if (unit++ % workers != index)
+				continue;
+			/* only looks up the table created by cell_pt_prepare */
+			sub_structs.root_table =
+				page_map_root_subtable(pt->pg_structs, slot,
+						       pt->coherent);
+			if (!sub_structs.root_table)
+				return -ENOMEM;
+			err = cell_pt_map(cell, pt, &sub_structs, slot,
+					  slot + pt->root_span);
+			if (err)
+				return err;
+		}
+	}
+	return 0;
+}
+
+/* The caches are an optimization only, partially filled ones are fine. */
+static void cell_pt_fill_caches(struct per_cpu *worker_data, struct cell *cell,
+				const struct cell_pt *pts)
+{
+	unsigned int type;
+
+	for (type = 0; type < NUM_CELL_PT_TYPES; type++)
+		if (pts[type].pg_structs->root_table)
+			page_cache_fill(&mem_pool, &cell->page_budget,
+					&worker_data->pt_cache[type],
+					pts[type].pg_structs->usage);
+}
+
+static void cell_pt_drain_caches(struct per_cpu *worker_data,
+				 struct cell *cell)
+{
+	unsigned int type;
+
+	for (type = 0; type < NUM_CELL_PT_TYPES; type++)
+		page_cache_drain(&mem_pool, &cell->page_budget,
+				 &worker_data->pt_cache[type]);
+}
+
+/*
+ * The EPT and VT-d page tables of the new cell are built by this CPU together
+ * with the CPUs that will be handed over to the cell, which are offline in the
+ * root cell at this point. The CPUs work below distinct root table entries, so
+ * they share no tables that are modified, and take the tables from caches
+ * that were filled from the cell's budget before.
+ */
+int arch_cell_create(struct per_cpu *cpu_data, struct cell *cell)
+{
+	const struct jailhouse_memory *mem;
+	struct cell_pt pts[NUM_CELL_PT_TYPES];
+	unsigned long start = get_cycles();
+	unsigned long cache_pages;
+	unsigned int cpu, n, workers = 1;
+	int err, work_err;
+
 	err = vmx_cell_init(cell);
 	if (err)
 		return err;
-	vmx_root_cell_shrink(cell->config);
-	flush_root_cell_cpu_caches(cpu_data);
 
 	err = vtd_cell_init(cell);
-	if (err)
+	if (err) {
 		vmx_cell_exit(cell);
+		return err;
+	}
+
+	cell_pt_get(cell, pts);
+	err = cell_pt_prepare(cell, pts);
+	if (err)
+		goto err_destroy;
+
+	for_each_cpu(cpu, cell->cpu_set)
+		workers++;
+
+	/* do without the caches if the pool runs short */
+	cache_pages = workers * NUM_CELL_PT_TYPES * PAGE_CACHE_PAGES;
+	if (page_budget_grow(&mem_pool, &cell->page_budget, cache_pages) == 0) {
+		cell_pt_fill_caches(cpu_data, cell, pts);
+		for_each_cpu(cpu, cell->cpu_set)
+			cell_pt_fill_caches(per_cpu(cpu), cell, pts);
+	} else {
+		cache_pages = 0;
+	}
+
+	for_each_cpu(cpu, cell->cpu_set) {
+		arch_suspend_cpu(cpu);
+		x86_start_cpu_work(cpu, cell_pt_build, cell);
+	}
+
+	err = cell_pt_build(cpu_data, cell);
+
+	for_each_cpu(cpu, cell->cpu_set) {
+		work_err = x86_wait_cpu_work(cpu);
+		if (!err)
+			err = work_err;
+		arch_resume_cpu(cpu);
+	}
+
+	cell_pt_drain_caches(cpu_data, cell);
+	for_each_cpu(cpu, cell->cpu_set)
+		cell_pt_drain_caches(per_cpu(cpu), cell);
+	page_budget_shrink(&mem_pool, &cell->page_budget, cache_pages);
+
+	printk("Built page tables of cell \"%s\" on %u CPUs in %lu cycles\n",
+	       cell->config->name, workers, get_cycles() - start);
+
+	if (err)
+		goto err_destroy;
+
+	return 0;
+
+err_destroy:
+	/* like cell_destroy_mappings, also releasing partially built tables */
+	mem = jailhouse_cell_mem_regions(cell->config);
+	for (n = 0; n < cell->config->num_memory_regions; n++, mem++)
+		arch_unmap_memory_region(cell, mem);
+	arch_cell_destroy(cpu_data, cell);
+	return err;
+}
+
+int arch_cell_commit(struct per_cpu *cpu_data, struct cell *cell)
+{
+	int err;
+
+	err = vtd_cell_assign_devices(cell);
+	if (err)
+		return err;
 	vtd_root_cell_shrink(cell->config);
 
+	vmx_root_cell_shrink(cell->config);
+	flush_root_cell_cpu_caches(cpu_data);
+
 	return 0;
 }
 
+void arch_cell_release(struct per_cpu *cpu_data, struct cell *cell)
+{
+	vtd_cell_release_devices(cell);
+	vmx_root_cell_grow(cell->config);
+	flush_root_cell_cpu_caches(cpu_data);
+}
+
 int arch_map_memory_region(struct cell *cell,
 			   const struct jailhouse_memory *mem)
 {
@@ -82,11 +457,17 @@ int arch_unmap_memory_region(struct cell *cell,
 	return vmx_unmap_memory_region(cell, mem);
 }
 
+void arch_cell_cpus_changed(struct cell *cell)
+{
+	/* fault events are reported to the first CPU of the root cell */
+	if (cell == &root_cell)
+		vtd_init_fault_nmi();
+}
+
 void arch_cell_destroy(struct per_cpu *cpu_data, struct cell *cell)
 {
 	vtd_cell_exit(cell);
 	vmx_cell_exit(cell);
-	flush_root_cell_cpu_caches(cpu_data);
 }
 
 void arch_shutdown(void)
@@ -181,7 +562,7 @@ static void x86_enter_wait_for_sipi(struct per_cpu *cpu_data)
 	cpu_data->init_signaled = false;
 	cpu_data->wait_for_sipi = true;
 	apic_clear();
-	vmx_cpu_park();
+	vmx_cpu_park(cpu_data);
 }
 
 int x86_handle_events(struct per_cpu *cpu_data)
@@ -201,8 +582,16 @@ int x86_handle_events(struct per_cpu *cpu_data)
 
 		spin_unlock(&cpu_data->control_lock);
 
-		while (cpu_data->stop_cpu)
+		while (cpu_data->stop_cpu) {
+			if (cpu_data->work_pending) {
+				cpu_data->work_result =
+					cpu_data->work(cpu_data,
+						       cpu_data->work_cell);
+				memory_barrier();
+				cpu_data->work_pending = false;
+			}
 			cpu_relax();
+		}
 
 		if (cpu_data->shutdown_cpu) {
 			apic_clear();
@@ -225,8 +614,9 @@ int x86_handle_events(struct per_cpu *cpu_data)
 
 	if (cpu_data->flush_caches) {
 		cpu_data->flush_caches = false;
-		x86_tlb_flush_all();
 		vmx_invept();
+		vmx_invvpid();
+		page_map_guest_tlb_flush(cpu_data);
 	}
 
 	spin_unlock(&cpu_data->control_lock);
@@ -49,15 +49,34 @@ static inline void x86_tlb_flush_all(void)
 	write_cr4(cr4);
 }
 
+static inline void arch_tlb_flush_all(void)
+{
+	x86_tlb_flush_all();
+}
+
 static inline void arch_tlb_flush_page(unsigned long addr)
 {
 	asm volatile("invlpg (%0)" : : "r" (addr));
 }
 
+static inline void clear_page(void *addr)
+{
+	unsigned long dummy1, dummy2;
+
+	asm volatile("rep stosq"
+		: "=c" (dummy1), "=D" (dummy2)
+		: "0" (PAGE_SIZE / sizeof(unsigned long)), "1" (addr), "a" (0UL)
+		: "memory");
+}
+
 extern unsigned long cache_line_size;
 
 static inline void flush_cache(void *addr, long size)
 {
+	/* the range may start in the middle of a cache line */
+	size += (unsigned long)addr & (cache_line_size - 1);
+	addr = (void *)((unsigned long)addr & ~(cache_line_size - 1));
+
 	for (; size > 0; size -= cache_line_size, addr += cache_line_size)
 		asm volatile("clflush %0" : "+m" (*(char *)addr));
 }
@@ -12,6 +12,41 @@
 
 #include <jailhouse/paging.h>
 
+#define X86_FLAG_HUGEPAGE	0x80
+
+#define X86_PHYS_ADDR_MASK	0x000ffffffffff000UL
+
+/*
+ * Generates a translation function that walks tables in x86-64 format with
+ * the given number of levels without going through struct paging. Huge pages
+ * are evaluated below the 512G level.
+ *
+ * Only EPT is walked by software on hot paths, once per guest page access and
+ * per level of a guest page walk. VT-d tables are only walked by the IOMMU,
+ * and hypervisor tables are not translated at runtime. Guest page tables can
+ * be in i386 format, and their walk is dominated by the temporary mapping of
+ * each level, so they keep using struct paging.
+ */
+#define X86_64_DEFINE_VIRT2PHYS(name, levels)				\
+static inline unsigned long name(page_table_t pt, unsigned long virt)	\
+{									\
+	unsigned int shift = 12 + 9 * ((levels) - 1);			\
+	unsigned long pte;						\
+									\
+	while (1) {							\
+		pte = pt[(virt >> shift) & 0x1ff];			\
+		if (!(pte & 1))						\
+			return INVALID_PHYS_ADDR;			\
+		if (shift == 12 ||					\
+		    (shift < 39 && (pte & X86_FLAG_HUGEPAGE)))		\
+			return (pte & X86_PHYS_ADDR_MASK &		\
+				~((1UL << shift) - 1)) |		\
+				(virt & ((1UL << shift) - 1));		\
+		pt = page_map_phys2hvirt(pte & X86_PHYS_ADDR_MASK);	\
+		shift -= 9;						\
+	}								\
+}
+
 extern const struct paging x86_64_paging[];
 extern const struct paging i386_paging[];
 
@@ -24,8 +24,15 @@
 #define PERCPU_STACK_END		PAGE_SIZE
 #define PERCPU_LINUX_SP			PERCPU_STACK_END
 
+/* Number of VMCS fields held in the per-CPU VMCS cache, see vmx.c */
+#define NUM_VMCS_CACHE_FIELDS		10
+
+/* Page table structures of a cell (EPT, VT-d), see control.c */
+#define NUM_CELL_PT_TYPES		2
+
 #ifndef __ASSEMBLY__
 
+#include <jailhouse/paging.h>
 #include <asm/cell.h>
 #include <asm/spinlock.h>
 
@@ -84,6 +91,32 @@ struct per_cpu {
 	int shutdown_state;
 	bool failed;
 
+	/** Statistics counters, cleared when the CPU changes its cell. */
+	u64 stats[JAILHOUSE_NUM_CPU_STATS];
+	/** VM exit latency histograms, reset by the CPU itself on request. */
+	struct jailhouse_cpu_latency latency;
+	volatile bool latency_reset;
+
+	/** Work executed on behalf of another CPU while this one is stopped,
+	 * see x86_start_cpu_work. */
+	int (*work)(struct per_cpu *cpu_data, struct cell *cell);
+	struct cell *work_cell;
+	int work_result;
+	volatile bool work_pending;
+	/** Page tables set aside for building the structures of a new cell,
+	 * one cache per structure type. */
+	struct page_cache pt_cache[NUM_CELL_PT_TYPES];
+
+	struct guest_tlb guest_tlb;
+
+	/** VMCS fields accessed during the current VM exit. Dirty fields are
+	 * written back before returning to the guest. */
+	struct {
+		unsigned long value[NUM_VMCS_CACHE_FIELDS];
+		u16 valid;
+		u16 dirty;
+	} vmcs_cache;
+
 	struct vmcs vmxon_region __attribute__((aligned(PAGE_SIZE)));
 	struct vmcs vmcs __attribute__((aligned(PAGE_SIZE)));
 } __attribute__((aligned(PAGE_SIZE)));
@@ -16,6 +16,8 @@
 #include <asm/types.h>
 
 #define X86_FEATURE_VMX					(1 << 5)
+#define X86_FEATURE_OSXSAVE				(1 << 27)
+#define X86_FEATURE_HYPERVISOR				(1U << 31)
 #define X86_FEATURE_GBPAGES				(1 << 26)
 
 #define X86_RFLAGS_VM					(1 << 17)
@@ -29,6 +31,7 @@
 #define X86_CR4_PAE					0x00000020
 #define X86_CR4_PGE					0x00000080
 #define X86_CR4_VMXE					0x00002000
+#define X86_CR4_OSXSAVE					0x00040000
 
 #define X86_XCR0_FP					0x00000001
 
@@ -136,6 +139,14 @@ static inline void memory_barrier(void)
 	asm volatile("mfence" : : : "memory");
 }
 
+static inline unsigned long get_cycles(void)
+{
+	unsigned int lo, hi;
+
+	asm volatile("rdtsc" : "=a" (lo), "=d" (hi));
+	return lo | ((unsigned long)hi << 32);
+}
+
 static inline void __cpuid(unsigned int *eax, unsigned int *ebx,
 			   unsigned int *ecx, unsigned int *edx)
 {
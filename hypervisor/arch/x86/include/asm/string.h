@@ -0,0 +1,20 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2013
+ *
+ * Authors:
+ *  Jan Kiszka <jan.kiszka@siemens.com>
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef _JAILHOUSE_ASM_STRING_H
+#define _JAILHOUSE_ASM_STRING_H
+
+/* provided by arch/x86/lib.c, based on string instructions */
+#define __HAVE_ARCH_MEMCPY
+#define __HAVE_ARCH_MEMSET
+
+#endif /* !_JAILHOUSE_ASM_STRING_H */
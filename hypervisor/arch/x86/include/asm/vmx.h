@@ -194,6 +194,7 @@ enum vmcs_field {
 
 #define SECONDARY_EXEC_VIRTUALIZE_APIC_ACCESSES	0x00000001
 #define SECONDARY_EXEC_ENABLE_EPT		0x00000002
+#define SECONDARY_EXEC_ENABLE_VPID		0x00000020
 #define SECONDARY_EXEC_UNRESTRICTED_GUEST	0x00000080
 
 #define VM_EXIT_HOST_ADDR_SPACE_SIZE		0x00000200
@@ -276,9 +277,16 @@ enum vmcs_field {
 #define EPT_MANDATORY_FEATURES			(EPT_PAGE_WALK_4 | EPTP_WB | \
 						 EPT_INVEPT)
 
+#define VPID_INVVPID				(1UL << 32)
+#define VPID_INVVPID_SINGLE			(1UL << 41)
+#define VPID_INVVPID_GLOBAL			(1UL << 42)
+
 #define VMX_INVEPT_SINGLE			1
 #define VMX_INVEPT_GLOBAL			2
 
+#define VMX_INVVPID_SINGLE			1
+#define VMX_INVVPID_GLOBAL			2
+
 #define APIC_ACCESS_OFFET_MASK			0x00000fff
 #define APIC_ACCESS_TYPE_MASK			0x0000f000
 #define APIC_ACCESS_TYPE_LINEAR_READ		0x00000000
@@ -288,6 +296,11 @@ int vmx_init(void);
 
 int vmx_cell_init(struct cell *cell);
 void vmx_root_cell_shrink(struct jailhouse_cell_desc *config);
+void vmx_root_cell_grow(struct jailhouse_cell_desc *config);
+unsigned long vmx_root_entry_span(void);
+int vmx_map_memory_range(struct cell *cell,
+			 const struct paging_structures *pg_structs,
+			 const struct jailhouse_memory *mem);
 int vmx_map_memory_region(struct cell *cell,
 			  const struct jailhouse_memory *mem);
 int vmx_unmap_memory_region(struct cell *cell,
@@ -298,10 +311,12 @@ int vmx_cpu_init(struct per_cpu *cpu_data);
 void vmx_cpu_exit(struct per_cpu *cpu_data);
 
 void __attribute__((noreturn)) vmx_cpu_activate_vmm(struct per_cpu *cpu_data);
-void vmx_handle_exit(struct registers *guest_regs, struct per_cpu *cpu_data);
+void vmx_handle_exit(struct registers *guest_regs, struct per_cpu *cpu_data,
+		     unsigned long entry_tsc);
 void vmx_entry_failure(struct per_cpu *cpu_data);
 
 void vmx_invept(void);
+void vmx_invvpid(void);
 
 void vmx_schedule_vmexit(struct per_cpu *cpu_data);
-void vmx_cpu_park(void);
+void vmx_cpu_park(struct per_cpu *cpu_data);
@@ -135,13 +135,21 @@ struct vtd_entry {
 
 
 int vtd_init(void);
+void vtd_init_fault_nmi(void);
 
 int vtd_cell_init(struct cell *cell);
+int vtd_cell_assign_devices(struct cell *cell);
 void vtd_root_cell_shrink(struct jailhouse_cell_desc *config);
+unsigned long vtd_root_entry_span(void);
+int vtd_map_memory_range(struct cell *cell,
+			 const struct paging_structures *pg_structs,
+			 const struct jailhouse_memory *mem);
 int vtd_map_memory_region(struct cell *cell,
 			  const struct jailhouse_memory *mem);
 int vtd_unmap_memory_region(struct cell *cell,
 			    const struct jailhouse_memory *mem);
+void vtd_cell_flush_caches(struct cell *cell);
+void vtd_cell_release_devices(struct cell *cell);
 void vtd_cell_exit(struct cell *cell);
 
 void vtd_shutdown(void);
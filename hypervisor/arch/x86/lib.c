@@ -0,0 +1,46 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2013
+ *
+ * Authors:
+ *  Jan Kiszka <jan.kiszka@siemens.com>
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include <jailhouse/string.h>
+#include <asm/types.h>
+
+/*
+ * Note: SSE-based variants are not an option as the hypervisor does not
+ * preserve the guest's FPU/SSE state.
+ */
+
+void *memcpy(void *dest, const void *src, unsigned long n)
+{
+	unsigned long dummy1, dummy2, dummy3;
+
+	asm volatile("rep movsq\n\t"
+		     "mov %4,%%rcx\n\t"
+		     "rep movsb"
+		     : "=&c" (dummy1), "=&D" (dummy2), "=&S" (dummy3)
+		     : "0" (n / 8), "r" (n % 8), "1" (dest), "2" (src)
+		     : "memory");
+	return dest;
+}
+
+void *memset(void *s, int c, unsigned long n)
+{
+	unsigned long dummy1, dummy2;
+
+	asm volatile("rep stosq\n\t"
+		     "mov %3,%%rcx\n\t"
+		     "rep stosb"
+		     : "=&c" (dummy1), "=&D" (dummy2)
+		     : "0" (n / 8), "r" (n % 8), "1" (s),
+		       "a" ((u8)c * 0x0101010101010101UL)
+		     : "memory");
+	return s;
+}
@@ -13,8 +13,6 @@
 #include <jailhouse/paging.h>
 #include <jailhouse/string.h>
 
-#define X86_FLAG_HUGEPAGE	0x80
-
 struct paging hv_paging[MAX_PAGE_DIR_LEVELS];
 
 static bool x86_64_entry_valid(pt_entry_t pte)
@@ -37,17 +35,6 @@ static void x86_64_clear_entry(pt_entry_t pte)
 	*pte = 0;
 }
 
-static bool x86_64_page_table_empty(page_table_t page_table)
-{
-	pt_entry_t pte;
-	int n;
-
-	for (n = 0, pte = page_table; n < PAGE_SIZE / sizeof(u64); n++, pte++)
-		if (x86_64_entry_valid(pte))
-			return false;
-	return true;
-}
-
 static pt_entry_t x86_64_get_entry_l4(page_table_t page_table,
 				      unsigned long virt)
 {
@@ -126,8 +113,7 @@ static unsigned long x86_64_get_next_pt_l23(pt_entry_t pte)
 	.entry_valid		= x86_64_entry_valid,		\
 	.get_flags		= x86_64_get_flags,		\
 	.set_next_pt		= x86_64_set_next_pt,		\
-	.clear_entry		= x86_64_clear_entry,		\
-	.page_table_empty	= x86_64_page_table_empty
+	.clear_entry		= x86_64_clear_entry
 
 const struct paging x86_64_paging[] = {
 	{
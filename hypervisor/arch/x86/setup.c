@@ -52,8 +52,10 @@ static void set_idt_int_gate(unsigned int vector, unsigned long entry)
 
 int arch_init_early(struct cell *root_cell)
 {
+	const struct jailhouse_memory *mem =
+		jailhouse_cell_mem_regions(root_cell->config);
 	unsigned long entry;
-	unsigned int vector;
+	unsigned int vector, n;
 	int err;
 
 	cache_line_size = (cpuid_ebx(1) & 0xff00) >> 5;
@@ -83,6 +85,12 @@ int arch_init_early(struct cell *root_cell)
 	if (err)
 		return err;
 
+	for (n = 0; n < root_cell->config->num_memory_regions; n++, mem++) {
+		err = vmx_map_memory_region(root_cell, mem);
+		if (err)
+			return err;
+	}
+
 	return 0;
 }
 
@@ -213,6 +221,9 @@ error_out:
 
 int arch_init_late(struct cell *root_cell)
 {
+	const struct jailhouse_memory *mem =
+		jailhouse_cell_mem_regions(root_cell->config);
+	unsigned int n;
 	int err;
 
 	err = vtd_init();
@@ -223,6 +234,16 @@ int arch_init_late(struct cell *root_cell)
 	if (err)
 		return err;
 
+	for (n = 0; n < root_cell->config->num_memory_regions; n++, mem++) {
+		err = vtd_map_memory_region(root_cell, mem);
+		if (err)
+			return err;
+	}
+
+	err = vtd_cell_assign_devices(root_cell);
+	if (err)
+		return err;
+
 	return 0;
 }
 
@@ -59,6 +59,8 @@ static u8 __attribute__((aligned(PAGE_SIZE))) apic_access_page[PAGE_SIZE];
 static struct paging ept_paging[EPT_PAGE_DIR_LEVELS];
 
 static unsigned int vmx_true_msr_offs;
+static bool vmx_vpid_enabled;
+static u64 vmx_invvpid_type;
 
 static bool vmxon(struct per_cpu *cpu_data)
 {
@@ -148,6 +150,68 @@ static bool vmcs_write32(unsigned long field, u32 value)
 	return vmcs_write64(field, value);
 }
 
+/*
+ * Fields that are accessed repeatedly while handling a VM exit. They are read
+ * at most once per exit and written back in one go before the VM entry. Any
+ * direct access to them has to be preceded by vmcs_cache_flush.
+ */
+enum vmcs_cache_index {
+	VMCS_CACHE_GUEST_RIP,
+	VMCS_CACHE_GUEST_RSP,
+	VMCS_CACHE_GUEST_RFLAGS,
+	VMCS_CACHE_GUEST_CR0,
+	VMCS_CACHE_GUEST_CR3,
+	VMCS_CACHE_GUEST_CR4,
+	VMCS_CACHE_GUEST_IA32_EFER,
+	VMCS_CACHE_GUEST_CS_SELECTOR,
+	VMCS_CACHE_VM_ENTRY_CONTROLS,
+	VMCS_CACHE_EXIT_QUALIFICATION,
+};
+
+static const unsigned long vmcs_cache_fields[NUM_VMCS_CACHE_FIELDS] = {
+	[VMCS_CACHE_GUEST_RIP] = GUEST_RIP,
+	[VMCS_CACHE_GUEST_RSP] = GUEST_RSP,
+	[VMCS_CACHE_GUEST_RFLAGS] = GUEST_RFLAGS,
+	[VMCS_CACHE_GUEST_CR0] = GUEST_CR0,
+	[VMCS_CACHE_GUEST_CR3] = GUEST_CR3,
+	[VMCS_CACHE_GUEST_CR4] = GUEST_CR4,
+	[VMCS_CACHE_GUEST_IA32_EFER] = GUEST_IA32_EFER,
+	[VMCS_CACHE_GUEST_CS_SELECTOR] = GUEST_CS_SELECTOR,
+	[VMCS_CACHE_VM_ENTRY_CONTROLS] = VM_ENTRY_CONTROLS,
+	[VMCS_CACHE_EXIT_QUALIFICATION] = EXIT_QUALIFICATION,
+};
+
+static unsigned long vmcs_cache_read(struct per_cpu *cpu_data,
+				     enum vmcs_cache_index index)
+{
+	if (!(cpu_data->vmcs_cache.valid & (1 << index))) {
+		cpu_data->vmcs_cache.value[index] =
+			vmcs_read64(vmcs_cache_fields[index]);
+		cpu_data->vmcs_cache.valid |= 1 << index;
+	}
+	return cpu_data->vmcs_cache.value[index];
+}
+
+static void vmcs_cache_write(struct per_cpu *cpu_data,
+			     enum vmcs_cache_index index, unsigned long value)
+{
+	cpu_data->vmcs_cache.value[index] = value;
+	cpu_data->vmcs_cache.valid |= 1 << index;
+	cpu_data->vmcs_cache.dirty |= 1 << index;
+}
+
+static void vmcs_cache_flush(struct per_cpu *cpu_data)
+{
+	unsigned int index;
+
+	for (index = 0; index < NUM_VMCS_CACHE_FIELDS; index++)
+		if (cpu_data->vmcs_cache.dirty & (1 << index))
+			vmcs_write64(vmcs_cache_fields[index],
+				     cpu_data->vmcs_cache.value[index]);
+	cpu_data->vmcs_cache.valid = 0;
+	cpu_data->vmcs_cache.dirty = 0;
+}
+
 static int vmx_check_features(void)
 {
 	unsigned long vmx_proc_ctrl, vmx_proc_ctrl2, ept_cap;
@@ -199,6 +263,13 @@ static int vmx_check_features(void)
 	if (!(read_msr(MSR_IA32_VMX_MISC) & VMX_MISC_ACTIVITY_HLT))
 		return -EIO;
 
+	/* use VPIDs if they can be invalidated selectively or globally */
+	vmx_vpid_enabled = (vmx_proc_ctrl2 & SECONDARY_EXEC_ENABLE_VPID) &&
+		(ept_cap & VPID_INVVPID) &&
+		(ept_cap & (VPID_INVVPID_SINGLE | VPID_INVVPID_GLOBAL));
+	vmx_invvpid_type = (ept_cap & VPID_INVVPID_SINGLE) ?
+		VMX_INVVPID_SINGLE : VMX_INVVPID_GLOBAL;
+
 	return 0;
 }
 
@@ -239,43 +310,159 @@ int vmx_init(void)
 	return 0;
 }
 
+X86_64_DEFINE_VIRT2PHYS(ept_virt2phys, EPT_PAGE_DIR_LEVELS)
+
 unsigned long arch_page_map_gphys2phys(struct per_cpu *cpu_data,
 				       unsigned long gphys)
 {
-	return page_map_virt2phys(&cpu_data->cell->vmx.ept_structs, gphys);
+	return ept_virt2phys(cpu_data->cell->vmx.ept_structs.root_table,
+			     gphys);
 }
 
+/* leaves with static results, served from the cell's CPUID cache */
+static const struct {
+	u32 function;
+	u32 index;
+	bool indexed;
+} cpuid_cached_leaves[] = {
+	{ 0x00000000 }, { 0x00000001 }, { 0x00000002 }, { 0x00000006 },
+	{ 0x00000007, 0, true },
+	{ 0x80000000 }, { 0x80000001 }, { 0x80000002 }, { 0x80000003 },
+	{ 0x80000004 }, { 0x80000006 }, { 0x80000007 }, { 0x80000008 },
+};
+
+static struct cpuid_cache_entry *
+vmx_cpuid_cache_lookup(struct cell *cell, u32 function, u32 index)
+{
+	struct cpuid_cache_entry *entry = cell->vmx.cpuid_cache;
+	unsigned int n;
+
+	for (n = 0; n < cell->vmx.cpuid_cache_entries; n++, entry++)
+		if (entry->function == function &&
+		    (!entry->indexed || entry->index == index))
+			return entry;
+	return NULL;
+}
+
+static struct cpuid_cache_entry *
+vmx_cpuid_cache_add(struct cell *cell, u32 function, u32 index, bool indexed)
+{
+	struct cpuid_cache_entry *entry;
+
+	if (cell->vmx.cpuid_cache_entries >= NUM_CPUID_CACHE_ENTRIES)
+		return NULL;
+
+	entry = &cell->vmx.cpuid_cache[cell->vmx.cpuid_cache_entries++];
+	entry->function = function;
+	entry->index = index;
+	entry->indexed = indexed;
+	entry->regs[JAILHOUSE_CPUID_EAX] = function;
+	entry->regs[JAILHOUSE_CPUID_ECX] = index;
+	__cpuid(&entry->regs[JAILHOUSE_CPUID_EAX],
+		&entry->regs[JAILHOUSE_CPUID_EBX],
+		&entry->regs[JAILHOUSE_CPUID_ECX],
+		&entry->regs[JAILHOUSE_CPUID_EDX]);
+
+	return entry;
+}
+
+/*
+ * Captures the CPUID results of the cell once and applies its masks. Leaves
+ * that depend on the executing CPU or on the guest's XCR0 cannot be cached,
+ * so they are always executed natively and cannot be masked.
+ */
+static int vmx_cpuid_cache_init(struct cell *cell)
+{
+	const struct jailhouse_cpuid_mask *mask =
+		jailhouse_cell_cpuid_masks(cell->config);
+	u32 max_basic = cpuid_eax(0x00000000);
+	u32 max_extended = cpuid_eax(0x80000000);
+	struct cpuid_cache_entry *entry;
+	u32 function, index;
+	unsigned int n, reg;
+	bool indexed;
+
+	cell->vmx.cpuid_cache_entries = 0;
+
+	for (n = 0; n < sizeof(cpuid_cached_leaves) /
+			sizeof(cpuid_cached_leaves[0]); n++) {
+		function = cpuid_cached_leaves[n].function;
+		if (function > (function & 0x80000000 ? max_extended :
+						       max_basic))
+			continue;
+		vmx_cpuid_cache_add(cell, function,
+				    cpuid_cached_leaves[n].index,
+				    cpuid_cached_leaves[n].indexed);
+	}
+
+	if (cell->config->flags & JAILHOUSE_CELL_CPUID_HYPERVISOR) {
+		entry = vmx_cpuid_cache_lookup(cell, 0x00000001, 0);
+		entry->regs[JAILHOUSE_CPUID_ECX] |= X86_FEATURE_HYPERVISOR;
+
+		entry = vmx_cpuid_cache_add(cell, 0x40000000, 0, false);
+		if (!entry)
+			return -E2BIG;
+		/* maximum leaf, signature "Jailhouse\0\0\0" */
+		entry->regs[JAILHOUSE_CPUID_EAX] = 0x40000000;
+		entry->regs[JAILHOUSE_CPUID_EBX] = 0x6c69614a;
+		entry->regs[JAILHOUSE_CPUID_ECX] = 0x73756f68;
+		entry->regs[JAILHOUSE_CPUID_EDX] = 0x00000065;
+	}
+
+	for (n = 0; n < cell->config->num_cpuid_masks; n++, mask++) {
+		if (mask->function == 0x0000000b ||
+		    mask->function == 0x0000000d ||
+		    mask->function == 0x0000001f)
+			return -EINVAL;
+
+		indexed = mask->index != JAILHOUSE_CPUID_NO_INDEX;
+		index = indexed ? mask->index : 0;
+		entry = vmx_cpuid_cache_lookup(cell, mask->function, index);
+		if (!entry)
+			entry = vmx_cpuid_cache_add(cell, mask->function,
+						    index, indexed);
+		if (!entry)
+			return -E2BIG;
+
+		for (reg = 0; reg < 4; reg++)
+			entry->regs[reg] &= ~mask->clear[reg];
+	}
+
+	return 0;
+}
+
+/* The memory regions of the cell are mapped separately. */
 int vmx_cell_init(struct cell *cell)
 {
 	struct jailhouse_cell_desc *config = cell->config;
-	const struct jailhouse_memory *mem =
-		jailhouse_cell_mem_regions(config);
 	const u8 *pio_bitmap = jailhouse_cell_pio_bitmap(config);
 	u32 pio_bitmap_size = config->pio_bitmap_size;
 	int n, err;
 	u32 size;
 
+	err = vmx_cpuid_cache_init(cell);
+	if (err)
+		return err;
+
 	/* build root cell EPT */
 	cell->vmx.ept_structs.root_paging = ept_paging;
-	cell->vmx.ept_structs.root_table = page_alloc(&mem_pool, 1);
+	cell->vmx.ept_structs.root_table =
+		page_budget_alloc(&mem_pool, &cell->page_budget, 1,
+				  PAGE_USAGE_CELL_PT);
+	cell->vmx.ept_structs.usage = PAGE_USAGE_CELL_PT;
+	cell->vmx.ept_structs.budget = &cell->page_budget;
 	if (!cell->vmx.ept_structs.root_table)
 		return -ENOMEM;
 
-	for (n = 0; n < config->num_memory_regions; n++, mem++) {
-		err = vmx_map_memory_region(cell, mem);
-		if (err)
-			/* FIXME: release vmx.ept_structs.root_table */
-			return err;
-	}
-
 	err = page_map_create(&cell->vmx.ept_structs,
 			      page_map_hvirt2phys(apic_access_page),
 			      PAGE_SIZE, XAPIC_BASE,
 			      EPT_FLAG_READ|EPT_FLAG_WRITE|EPT_FLAG_WB_TYPE,
 			      PAGE_MAP_NON_COHERENT);
-	if (err)
-		/* FIXME: release vmx.ept_structs.root_table */
+	if (err) {
+		vmx_cell_exit(cell);
 		return err;
+	}
 
 	memset(cell->vmx.io_bitmap, -1, sizeof(cell->vmx.io_bitmap));
 
@@ -303,8 +490,19 @@ void vmx_root_cell_shrink(struct jailhouse_cell_desc *config)
 	vmx_invept();
 }
 
-int vmx_map_memory_region(struct cell *cell,
-			  const struct jailhouse_memory *mem)
+/* Returns the guest-physical range covered by one entry of the root table. */
+unsigned long vmx_root_entry_span(void)
+{
+	return 1UL << (12 + 9 * (EPT_PAGE_DIR_LEVELS - 1));
+}
+
+/*
+ * Maps the memory region into the given EPT structures of the cell, which may
+ * also be rooted below the top level.
+ */
+int vmx_map_memory_range(struct cell *cell,
+			 const struct paging_structures *pg_structs,
+			 const struct jailhouse_memory *mem)
 {
 	u64 phys_start = mem->phys_start;
 	u32 flags = EPT_FLAG_WB_TYPE;
@@ -318,10 +516,16 @@ int vmx_map_memory_region(struct cell *cell,
 	if (mem->flags & JAILHOUSE_MEM_COMM_REGION)
 		phys_start = page_map_hvirt2phys(&cell->comm_page);
 
-	return page_map_create(&cell->vmx.ept_structs, phys_start, mem->size,
+	return page_map_create(pg_structs, phys_start, mem->size,
 			       mem->virt_start, flags, PAGE_MAP_NON_COHERENT);
 }
 
+int vmx_map_memory_region(struct cell *cell,
+			  const struct jailhouse_memory *mem)
+{
+	return vmx_map_memory_range(cell, &cell->vmx.ept_structs, mem);
+}
+
 int vmx_unmap_memory_region(struct cell *cell,
 			    const struct jailhouse_memory *mem)
 {
@@ -329,26 +533,29 @@ int vmx_unmap_memory_region(struct cell *cell,
 				mem->size, PAGE_MAP_NON_COHERENT);
 }
 
-void vmx_cell_exit(struct cell *cell)
+void vmx_root_cell_grow(struct jailhouse_cell_desc *config)
 {
 	const u8 *root_pio_bitmap =
 		jailhouse_cell_pio_bitmap(root_cell.config);
-	struct jailhouse_cell_desc *config = cell->config;
 	const u8 *pio_bitmap = jailhouse_cell_pio_bitmap(config);
 	u32 pio_bitmap_size = config->pio_bitmap_size;
 	u8 *b;
 
-	page_map_destroy(&cell->vmx.ept_structs, XAPIC_BASE, PAGE_SIZE,
-			 PAGE_MAP_NON_COHERENT);
-
 	if (root_cell.config->pio_bitmap_size < pio_bitmap_size)
 		pio_bitmap_size = root_cell.config->pio_bitmap_size;
 
 	for (b = root_cell.vmx.io_bitmap; pio_bitmap_size > 0;
 	     b++, pio_bitmap++, root_pio_bitmap++, pio_bitmap_size--)
 		*b &= *pio_bitmap | *root_pio_bitmap;
+}
+
+void vmx_cell_exit(struct cell *cell)
+{
+	page_map_destroy(&cell->vmx.ept_structs, XAPIC_BASE, PAGE_SIZE,
+			 PAGE_MAP_NON_COHERENT);
 
-	page_free(&mem_pool, cell->vmx.ept_structs.root_table, 1);
+	page_budget_free(&mem_pool, &cell->page_budget,
+			 cell->vmx.ept_structs.root_table, 1);
 }
 
 void vmx_invept(void)
@@ -383,6 +590,42 @@ void vmx_invept(void)
 	}
 }
 
+/*
+ * Drops the linear translations of the current guest. Without VPIDs, every VM
+ * transition already does this implicitly, only the host TLB is flushed then.
+ */
+void vmx_invvpid(void)
+{
+	struct {
+		u64 vpid;
+		u64 linear_address;
+	} descriptor;
+	u8 ok;
+
+	if (!vmx_vpid_enabled) {
+		x86_tlb_flush_all();
+		return;
+	}
+
+	descriptor.linear_address = 0;
+	if (vmx_invvpid_type == VMX_INVVPID_SINGLE)
+		descriptor.vpid = vmcs_read16(VIRTUAL_PROCESSOR_ID);
+	else
+		descriptor.vpid = 0;
+	asm volatile(
+		"invvpid (%1),%2\n\t"
+		"seta %0\n\t"
+		: "=qm" (ok)
+		: "r" (&descriptor), "r" (vmx_invvpid_type)
+		: "memory", "cc");
+
+	if (!ok) {
+		panic_printk("FATAL: invvpid failed, error %d\n",
+			     vmcs_read32(VM_INSTRUCTION_ERROR));
+		panic_stop(NULL);
+	}
+}
+
 static bool vmx_set_guest_cr(int cr, unsigned long val)
 {
 	unsigned long fixed0, fixed1, required1;
@@ -424,6 +667,10 @@ static bool vmx_set_cell_config(struct cell *cell)
 			page_map_hvirt2phys(cell->vmx.ept_structs.root_table) |
 			EPT_TYPE_WRITEBACK | EPT_PAGE_WALK_LEN);
 
+	/* VPID 0 is reserved for the host, so tag guests with their ID + 1 */
+	if (vmx_vpid_enabled)
+		ok &= vmcs_write16(VIRTUAL_PROCESSOR_ID, cell->id + 1);
+
 	return ok;
 }
 
@@ -537,6 +784,8 @@ static bool vmcs_setup(struct per_cpu *cpu_data)
 	val = read_msr(MSR_IA32_VMX_PROCBASED_CTLS2);
 	val |= SECONDARY_EXEC_VIRTUALIZE_APIC_ACCESSES |
 		SECONDARY_EXEC_ENABLE_EPT | SECONDARY_EXEC_UNRESTRICTED_GUEST;
+	if (vmx_vpid_enabled)
+		val |= SECONDARY_EXEC_ENABLE_VPID;
 	ok &= vmcs_write32(SECONDARY_VM_EXEC_CONTROL, val);
 
 	ok &= vmcs_write64(APIC_ACCESS_ADDR,
@@ -661,8 +910,13 @@ void vmx_cpu_activate_vmm(struct per_cpu *cpu_data)
 static void __attribute__((noreturn))
 vmx_cpu_deactivate_vmm(struct registers *guest_regs, struct per_cpu *cpu_data)
 {
-	unsigned long *stack = (unsigned long *)vmcs_read64(GUEST_RSP);
-	unsigned long linux_ip = vmcs_read64(GUEST_RIP);
+	unsigned long *stack, linux_ip;
+
+	/* the instruction pointer was already advanced in the cache */
+	vmcs_cache_flush(cpu_data);
+
+	stack = (unsigned long *)vmcs_read64(GUEST_RSP);
+	linux_ip = vmcs_read64(GUEST_RIP);
 
 	cpu_data->linux_cr3 = vmcs_read64(GUEST_CR3);
 
@@ -723,6 +977,9 @@ static void vmx_cpu_reset(struct registers *guest_regs,
 	unsigned long val;
 	bool ok = true;
 
+	vmcs_cache_flush(cpu_data);
+	page_map_guest_tlb_flush(cpu_data);
+
 	ok &= vmx_set_guest_cr(0, X86_CR0_NW | X86_CR0_CD | X86_CR0_ET);
 	ok &= vmx_set_guest_cr(4, 0);
 
@@ -807,6 +1064,16 @@ static void vmx_cpu_reset(struct registers *guest_regs,
 		panic_printk("FATAL: CPU reset failed\n");
 		panic_stop(cpu_data);
 	}
+
+	/*
+	 * The CPU may have been moved from another cell. Drop what it still
+	 * caches for the EPT of its cell from an earlier assignment. VPIDs are
+	 * reused along with cell IDs, so drop the linear translations as well.
+	 */
+	vmx_invept();
+	if (vmx_vpid_enabled)
+		vmx_invvpid();
+	page_map_guest_tlb_flush(cpu_data);
 }
 
 void vmx_schedule_vmexit(struct per_cpu *cpu_data)
@@ -821,8 +1088,9 @@ void vmx_schedule_vmexit(struct per_cpu *cpu_data)
 	vmcs_write32(PIN_BASED_VM_EXEC_CONTROL, pin_based_ctrl);
 }
 
-void vmx_cpu_park(void)
+void vmx_cpu_park(struct per_cpu *cpu_data)
 {
+	vmcs_cache_flush(cpu_data);
 	vmcs_write64(GUEST_RFLAGS, 0x02);
 	vmcs_write32(GUEST_ACTIVITY_STATE, GUEST_ACTIVITY_HLT);
 }
@@ -835,32 +1103,77 @@ static void vmx_disable_preemption_timer(void)
 	vmcs_write32(PIN_BASED_VM_EXEC_CONTROL, pin_based_ctrl);
 }
 
-static void vmx_skip_emulated_instruction(unsigned int inst_len)
+static void vmx_skip_emulated_instruction(struct per_cpu *cpu_data,
+					  unsigned int inst_len)
 {
-	vmcs_write64(GUEST_RIP, vmcs_read64(GUEST_RIP) + inst_len);
+	vmcs_cache_write(cpu_data, VMCS_CACHE_GUEST_RIP,
+			 vmcs_cache_read(cpu_data, VMCS_CACHE_GUEST_RIP) +
+			 inst_len);
 }
 
-static void update_efer(void)
+static void update_efer(struct per_cpu *cpu_data)
 {
-	unsigned long efer = vmcs_read64(GUEST_IA32_EFER);
+	unsigned long efer =
+		vmcs_cache_read(cpu_data, VMCS_CACHE_GUEST_IA32_EFER);
 
 	if ((efer & (EFER_LME | EFER_LMA)) != EFER_LME)
 		return;
 
 	efer |= EFER_LMA;
-	vmcs_write64(GUEST_IA32_EFER, efer);
-	vmcs_write32(VM_ENTRY_CONTROLS,
-		     vmcs_read32(VM_ENTRY_CONTROLS) | VM_ENTRY_IA32E_MODE);
+	vmcs_cache_write(cpu_data, VMCS_CACHE_GUEST_IA32_EFER, efer);
+	vmcs_cache_write(cpu_data, VMCS_CACHE_VM_ENTRY_CONTROLS,
+			 vmcs_cache_read(cpu_data,
+					 VMCS_CACHE_VM_ENTRY_CONTROLS) |
+			 VM_ENTRY_IA32E_MODE);
+}
+
+static void vmx_handle_cpuid(struct registers *guest_regs,
+			     struct per_cpu *cpu_data)
+{
+	u32 function = guest_regs->rax;
+	u32 index = guest_regs->rcx;
+	struct cpuid_cache_entry *entry;
+	u32 regs[4];
+
+	entry = vmx_cpuid_cache_lookup(cpu_data->cell, function, index);
+	if (entry) {
+		memcpy(regs, entry->regs, sizeof(regs));
+		if (function == 0x00000001) {
+			/* initial APIC ID and OSXSAVE differ per CPU */
+			regs[JAILHOUSE_CPUID_EBX] &= 0x00ffffff;
+			regs[JAILHOUSE_CPUID_EBX] |= cpu_data->apic_id << 24;
+			regs[JAILHOUSE_CPUID_ECX] &= ~X86_FEATURE_OSXSAVE;
+			if (vmcs_cache_read(cpu_data, VMCS_CACHE_GUEST_CR4) &
+			    X86_CR4_OSXSAVE)
+				regs[JAILHOUSE_CPUID_ECX] |=
+					X86_FEATURE_OSXSAVE;
+		}
+	} else {
+		regs[JAILHOUSE_CPUID_EAX] = function;
+		regs[JAILHOUSE_CPUID_ECX] = index;
+		__cpuid(&regs[JAILHOUSE_CPUID_EAX],
+			&regs[JAILHOUSE_CPUID_EBX],
+			&regs[JAILHOUSE_CPUID_ECX],
+			&regs[JAILHOUSE_CPUID_EDX]);
+	}
+
+	guest_regs->rax = regs[JAILHOUSE_CPUID_EAX];
+	guest_regs->rbx = regs[JAILHOUSE_CPUID_EBX];
+	guest_regs->rcx = regs[JAILHOUSE_CPUID_ECX];
+	guest_regs->rdx = regs[JAILHOUSE_CPUID_EDX];
 }
 
 static void vmx_handle_hypercall(struct registers *guest_regs,
 				 struct per_cpu *cpu_data)
 {
-	vmx_skip_emulated_instruction(X86_INST_LEN_VMCALL);
-
-	if ((!(vmcs_read64(GUEST_IA32_EFER) & EFER_LMA) &&
-	     vmcs_read64(GUEST_RFLAGS) & X86_RFLAGS_VM) ||
-	    (vmcs_read16(GUEST_CS_SELECTOR) & 3) != 0) {
+	vmx_skip_emulated_instruction(cpu_data, X86_INST_LEN_VMCALL);
+
+	if ((!(vmcs_cache_read(cpu_data, VMCS_CACHE_GUEST_IA32_EFER) &
+	       EFER_LMA) &&
+	     vmcs_cache_read(cpu_data, VMCS_CACHE_GUEST_RFLAGS) &
+	     X86_RFLAGS_VM) ||
+	    (vmcs_cache_read(cpu_data, VMCS_CACHE_GUEST_CS_SELECTOR) & 3)
+	    != 0) {
 		guest_regs->rax = -EPERM;
 		return;
 	}
@@ -887,10 +1200,40 @@ static void vmx_handle_hypercall(struct registers *guest_regs,
 	case JAILHOUSE_HC_CPU_GET_STATE:
 		guest_regs->rax = cpu_get_state(cpu_data, guest_regs->rdi);
 		break;
+	case JAILHOUSE_HC_CELL_GET_INFO:
+		guest_regs->rax = cell_get_info(cpu_data, guest_regs->rdi,
+						guest_regs->rsi);
+		break;
+	case JAILHOUSE_HC_CELL_START:
+		guest_regs->rax = cell_start(cpu_data, guest_regs->rdi,
+					     guest_regs->rsi);
+		break;
+	case JAILHOUSE_HC_CELL_MEM_ATTACH:
+		guest_regs->rax = cell_mem_attach(cpu_data, guest_regs->rdi,
+						  guest_regs->rsi);
+		break;
+	case JAILHOUSE_HC_CELL_MEM_DETACH:
+		guest_regs->rax = cell_mem_detach(cpu_data, guest_regs->rdi,
+						  guest_regs->rsi);
+		break;
+	case JAILHOUSE_HC_CPU_MOVE:
+		guest_regs->rax = cpu_move(cpu_data, guest_regs->rdi,
+					   guest_regs->rsi);
+		break;
+	case JAILHOUSE_HC_CELL_GET_STAT:
+		guest_regs->rax = cell_get_stat(cpu_data, guest_regs->rdi,
+						guest_regs->rsi);
+		break;
+	case JAILHOUSE_HC_CPU_GET_LATENCY:
+		guest_regs->rax = cpu_get_latency(cpu_data, guest_regs->rdi,
+						  guest_regs->rsi,
+						  guest_regs->rdx);
+		break;
 	default:
 		printk("CPU %d: Unknown vmcall %d, RIP: %p\n",
 		       cpu_data->cpu_id, guest_regs->rax,
-		       vmcs_read64(GUEST_RIP) - X86_INST_LEN_VMCALL);
+		       vmcs_cache_read(cpu_data, VMCS_CACHE_GUEST_RIP) -
+		       X86_INST_LEN_VMCALL);
 		guest_regs->rax = -ENOSYS;
 		break;
 	}
@@ -899,7 +1242,8 @@ static void vmx_handle_hypercall(struct registers *guest_regs,
 static bool vmx_handle_cr(struct registers *guest_regs,
 			  struct per_cpu *cpu_data)
 {
-	u64 exit_qualification = vmcs_read64(EXIT_QUALIFICATION);
+	u64 exit_qualification =
+		vmcs_cache_read(cpu_data, VMCS_CACHE_EXIT_QUALIFICATION);
 	unsigned long cr, reg, val;
 
 	cr = exit_qualification & 0xf;
@@ -908,16 +1252,23 @@ static bool vmx_handle_cr(struct registers *guest_regs,
 	switch ((exit_qualification >> 4) & 3) {
 	case 0: /* move to cr */
 		if (reg == 4)
-			val = vmcs_read64(GUEST_RSP);
+			val = vmcs_cache_read(cpu_data, VMCS_CACHE_GUEST_RSP);
 		else
 			val = ((unsigned long *)guest_regs)[15 - reg];
 
 		if (cr == 0 || cr == 4) {
-			vmx_skip_emulated_instruction(X86_INST_LEN_MOV_TO_CR);
+			vmx_skip_emulated_instruction(cpu_data,
+						      X86_INST_LEN_MOV_TO_CR);
 			/* TODO: check for #GP reasons */
+			vmcs_cache_flush(cpu_data);
 			vmx_set_guest_cr(cr, val);
 			if (cr == 0 && val & X86_CR0_PG)
-				update_efer();
+				update_efer(cpu_data);
+			/* the guest expects its TLB to be flushed */
+			if (vmx_vpid_enabled)
+				vmx_invvpid();
+			/* paging mode may have changed */
+			page_map_guest_tlb_flush(cpu_data);
 			return true;
 		}
 		break;
@@ -930,17 +1281,23 @@ static bool vmx_handle_cr(struct registers *guest_regs,
 }
 
 static bool
-vmx_get_guest_paging_structs(struct guest_paging_structures *pg_structs)
+vmx_get_guest_paging_structs(struct per_cpu *cpu_data,
+			     struct guest_paging_structures *pg_structs)
 {
-	if (vmcs_read32(VM_ENTRY_CONTROLS) & VM_ENTRY_IA32E_MODE) {
+	if (vmcs_cache_read(cpu_data, VMCS_CACHE_VM_ENTRY_CONTROLS) &
+	    VM_ENTRY_IA32E_MODE) {
 		pg_structs->root_paging = x86_64_paging;
 		pg_structs->root_table_gphys =
-			vmcs_read64(GUEST_CR3) & 0x000ffffffffff000UL;
-	} else if (vmcs_read64(GUEST_CR0) & X86_CR0_PG &&
-		 !(vmcs_read64(GUEST_CR4) & X86_CR4_PAE)) {
+			vmcs_cache_read(cpu_data, VMCS_CACHE_GUEST_CR3) &
+			0x000ffffffffff000UL;
+	} else if (vmcs_cache_read(cpu_data, VMCS_CACHE_GUEST_CR0) &
+		   X86_CR0_PG &&
+		   !(vmcs_cache_read(cpu_data, VMCS_CACHE_GUEST_CR4) &
+		     X86_CR4_PAE)) {
 		pg_structs->root_paging = i386_paging;
 		pg_structs->root_table_gphys =
-			vmcs_read64(GUEST_CR3) & 0xfffff000UL;
+			vmcs_cache_read(cpu_data, VMCS_CACHE_GUEST_CR3) &
+			0xfffff000UL;
 	} else {
 		printk("FATAL: Unsupported paging mode\n");
 		return false;
@@ -954,9 +1311,11 @@ static bool vmx_handle_apic_access(struct registers *guest_regs,
 	struct guest_paging_structures pg_structs;
 	unsigned int inst_len, offset;
 	u64 qualification;
+	unsigned long rip;
 	bool is_write;
 
-	qualification = vmcs_read64(EXIT_QUALIFICATION);
+	qualification = vmcs_cache_read(cpu_data,
+					VMCS_CACHE_EXIT_QUALIFICATION);
 
 	switch (qualification & APIC_ACCESS_TYPE_MASK) {
 	case APIC_ACCESS_TYPE_LINEAR_READ:
@@ -966,17 +1325,20 @@ static bool vmx_handle_apic_access(struct registers *guest_regs,
 		if (offset & 0x00f)
 			break;
 
-		if (!vmx_get_guest_paging_structs(&pg_structs))
+		if (offset >> 4 == APIC_REG_ICR)
+			cpu_data->stats[JAILHOUSE_CPU_STAT_VMEXITS_XAPIC_ICR]++;
+
+		if (!vmx_get_guest_paging_structs(cpu_data, &pg_structs))
 			break;
 
-		inst_len = apic_mmio_access(guest_regs, cpu_data,
-					    vmcs_read64(GUEST_RIP),
+		rip = vmcs_cache_read(cpu_data, VMCS_CACHE_GUEST_RIP);
+		inst_len = apic_mmio_access(guest_regs, cpu_data, rip,
 					    &pg_structs, offset >> 4,
 					    is_write);
 		if (!inst_len)
 			return false;
 
-		vmx_skip_emulated_instruction(inst_len);
+		vmx_skip_emulated_instruction(cpu_data, inst_len);
 		return true;
 	}
 	panic_printk("FATAL: Unhandled APIC access, "
@@ -1015,11 +1377,14 @@ static void dump_guest_regs(struct registers *guest_regs)
 	panic_printk("EFER: %p\n", vmcs_read64(GUEST_IA32_EFER));
 }
 
-void vmx_handle_exit(struct registers *guest_regs, struct per_cpu *cpu_data)
+static void vmx_dispatch_exit(struct registers *guest_regs,
+			      struct per_cpu *cpu_data, u32 reason)
 {
-	u32 reason = vmcs_read32(VM_EXIT_REASON);
+	u64 *stats = cpu_data->stats;
 	int sipi_vector;
 
+	stats[JAILHOUSE_CPU_STAT_VMEXITS_TOTAL]++;
+
 	if (reason & EXIT_REASONS_FAILED_VMENTRY) {
 		panic_printk("FATAL: VM-Entry failure, reason %d\n",
 			     (u16)reason);
@@ -1032,6 +1397,7 @@ void vmx_handle_exit(struct registers *guest_regs, struct per_cpu *cpu_data)
 		asm volatile("int %0" : : "i" (NMI_VECTOR));
 		/* fall through */
 	case EXIT_REASON_PREEMPTION_TIMER:
+		stats[JAILHOUSE_CPU_STAT_VMEXITS_MANAGEMENT]++;
 		vmx_disable_preemption_timer();
 		sipi_vector = x86_handle_events(cpu_data);
 		if (sipi_vector >= 0) {
@@ -1042,25 +1408,25 @@ void vmx_handle_exit(struct registers *guest_regs, struct per_cpu *cpu_data)
 		vtd_check_pending_faults(cpu_data);
 		return;
 	case EXIT_REASON_CPUID:
-		vmx_skip_emulated_instruction(X86_INST_LEN_CPUID);
-		guest_regs->rax &= 0xffffffff;
-		guest_regs->rbx &= 0xffffffff;
-		guest_regs->rcx &= 0xffffffff;
-		guest_regs->rdx &= 0xffffffff;
-		__cpuid((u32 *)&guest_regs->rax, (u32 *)&guest_regs->rbx,
-			(u32 *)&guest_regs->rcx, (u32 *)&guest_regs->rdx);
+		stats[JAILHOUSE_CPU_STAT_VMEXITS_CPUID]++;
+		vmx_skip_emulated_instruction(cpu_data, X86_INST_LEN_CPUID);
+		vmx_handle_cpuid(guest_regs, cpu_data);
 		return;
 	case EXIT_REASON_VMCALL:
+		stats[JAILHOUSE_CPU_STAT_VMEXITS_HYPERCALL]++;
 		vmx_handle_hypercall(guest_regs, cpu_data);
 		return;
 	case EXIT_REASON_CR_ACCESS:
+		stats[JAILHOUSE_CPU_STAT_VMEXITS_CR]++;
 		if (vmx_handle_cr(guest_regs, cpu_data))
 			return;
 		break;
 	case EXIT_REASON_MSR_READ:
-		vmx_skip_emulated_instruction(X86_INST_LEN_RDMSR);
+		stats[JAILHOUSE_CPU_STAT_VMEXITS_MSR]++;
+		vmx_skip_emulated_instruction(cpu_data, X86_INST_LEN_RDMSR);
 		if (guest_regs->rcx >= MSR_X2APIC_BASE &&
 		    guest_regs->rcx <= MSR_X2APIC_END) {
+			stats[JAILHOUSE_CPU_STAT_VMEXITS_X2APIC]++;
 			x2apic_handle_read(guest_regs);
 			return;
 		}
@@ -1068,8 +1434,10 @@ void vmx_handle_exit(struct registers *guest_regs, struct per_cpu *cpu_data)
 			     guest_regs->rcx);
 		break;
 	case EXIT_REASON_MSR_WRITE:
-		vmx_skip_emulated_instruction(X86_INST_LEN_WRMSR);
+		stats[JAILHOUSE_CPU_STAT_VMEXITS_MSR]++;
+		vmx_skip_emulated_instruction(cpu_data, X86_INST_LEN_WRMSR);
 		if (guest_regs->rcx == MSR_X2APIC_ICR) {
+			stats[JAILHOUSE_CPU_STAT_VMEXITS_X2APIC_ICR]++;
 			if (!apic_handle_icr_write(cpu_data, guest_regs->rax,
 						   guest_regs->rdx))
 				break;
@@ -1077,6 +1445,7 @@ void vmx_handle_exit(struct registers *guest_regs, struct per_cpu *cpu_data)
 		}
 		if (guest_regs->rcx >= MSR_X2APIC_BASE &&
 		    guest_regs->rcx <= MSR_X2APIC_END) {
+			stats[JAILHOUSE_CPU_STAT_VMEXITS_X2APIC]++;
 			x2apic_handle_write(guest_regs);
 			return;
 		}
@@ -1084,11 +1453,13 @@ void vmx_handle_exit(struct registers *guest_regs, struct per_cpu *cpu_data)
 			     guest_regs->rcx);
 		break;
 	case EXIT_REASON_APIC_ACCESS:
+		stats[JAILHOUSE_CPU_STAT_VMEXITS_XAPIC]++;
 		if (vmx_handle_apic_access(guest_regs, cpu_data))
 			return;
 		break;
 	case EXIT_REASON_XSETBV:
-		vmx_skip_emulated_instruction(X86_INST_LEN_XSETBV);
+		stats[JAILHOUSE_CPU_STAT_VMEXITS_XSETBV]++;
+		vmx_skip_emulated_instruction(cpu_data, X86_INST_LEN_XSETBV);
 		if (guest_regs->rax & X86_XCR0_FP &&
 		    (guest_regs->rax & ~cpuid_eax(0x0d)) == 0 &&
 		    guest_regs->rcx == 0 && guest_regs->rdx == 0) {
@@ -1112,6 +1483,64 @@ void vmx_handle_exit(struct registers *guest_regs, struct per_cpu *cpu_data)
 	panic_halt(cpu_data);
 }
 
+static unsigned int vmx_latency_class(u32 reason)
+{
+	switch (reason) {
+	case EXIT_REASON_EXCEPTION_NMI:
+	case EXIT_REASON_PREEMPTION_TIMER:
+		return JAILHOUSE_LATENCY_MANAGEMENT;
+	case EXIT_REASON_VMCALL:
+		return JAILHOUSE_LATENCY_HYPERCALL;
+	case EXIT_REASON_CPUID:
+		return JAILHOUSE_LATENCY_CPUID;
+	case EXIT_REASON_CR_ACCESS:
+		return JAILHOUSE_LATENCY_CR;
+	case EXIT_REASON_MSR_READ:
+	case EXIT_REASON_MSR_WRITE:
+		return JAILHOUSE_LATENCY_MSR;
+	case EXIT_REASON_APIC_ACCESS:
+		return JAILHOUSE_LATENCY_XAPIC;
+	case EXIT_REASON_XSETBV:
+		return JAILHOUSE_LATENCY_XSETBV;
+	default:
+		return JAILHOUSE_LATENCY_OTHER;
+	}
+}
+
+static void vmx_account_latency(struct per_cpu *cpu_data, u32 reason,
+				unsigned long cycles)
+{
+	struct jailhouse_cpu_latency *latency = &cpu_data->latency;
+	unsigned int class = vmx_latency_class(reason);
+	unsigned int bucket;
+
+	/* resetting here avoids racing with the CPU's own updates */
+	if (cpu_data->latency_reset) {
+		memset(latency, 0, sizeof(*latency));
+		cpu_data->latency_reset = false;
+	}
+
+	bucket = cycles ? BITS_PER_LONG - 1 - __builtin_clzl(cycles) : 0;
+	if (bucket >= JAILHOUSE_LATENCY_BUCKETS)
+		bucket = JAILHOUSE_LATENCY_BUCKETS - 1;
+
+	latency->buckets[class][bucket]++;
+	if (cycles > latency->max_cycles[class])
+		latency->max_cycles[class] = cycles;
+}
+
+void vmx_handle_exit(struct registers *guest_regs, struct per_cpu *cpu_data,
+		     unsigned long entry_tsc)
+{
+	u32 reason = vmcs_read32(VM_EXIT_REASON);
+
+	vmx_dispatch_exit(guest_regs, cpu_data, reason);
+	vmcs_cache_flush(cpu_data);
+
+	/* the remaining path up to vmresume only restores registers */
+	vmx_account_latency(cpu_data, reason, get_cycles() - entry_tsc);
+}
+
 void vmx_entry_failure(struct per_cpu *cpu_data)
 {
 	panic_printk("FATAL: vmresume failed, error %d\n",
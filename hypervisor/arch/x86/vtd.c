@@ -72,7 +72,7 @@ static void vtd_set_next_pt(pt_entry_t pte, unsigned long next_pt)
 		VTD_PAGE_WRITE;
 }
 
-static void vtd_init_fault_nmi(void)
+void vtd_init_fault_nmi(void)
 {
 	void *reg_base = dmar_reg_base;
 	struct per_cpu *cpu_data;
@@ -227,7 +227,7 @@ int vtd_init(void)
 
 		printk("Found DMAR @%p\n", drhd->register_base_addr);
 
-		reg_base = page_alloc(&remap_pool, 1);
+		reg_base = page_alloc(&remap_pool, 1, PAGE_USAGE_OTHER);
 		if (!reg_base)
 			return -ENOMEM;
 
@@ -315,7 +315,8 @@ static bool vtd_add_device_to_cell(struct cell *cell,
 		context_entry_table =
 			page_map_phys2hvirt(root_entry_lo & PAGE_MASK);
 	} else {
-		context_entry_table = page_alloc(&mem_pool, 1);
+		context_entry_table = page_alloc(&mem_pool, 1,
+						 PAGE_USAGE_IOMMU_PT);
 		if (!context_entry_table)
 			return false;
 		root_entry_table[device->bus].lo_word = VTD_ROOT_PRESENT |
@@ -335,16 +336,9 @@ static bool vtd_add_device_to_cell(struct cell *cell,
 	return true;
 }
 
+/* The memory regions of the cell are mapped separately. */
 int vtd_cell_init(struct cell *cell)
 {
-	struct jailhouse_cell_desc *config = cell->config;
-	const struct jailhouse_memory *mem =
-		jailhouse_cell_mem_regions(config);
-	const struct jailhouse_pci_device *dev =
-		jailhouse_cell_pci_devices(cell->config);
-	void *reg_base = dmar_reg_base;
-	int n, err;
-
 	// HACK for QEMU
 	if (dmar_units == 0)
 		return 0;
@@ -353,18 +347,29 @@ int vtd_cell_init(struct cell *cell)
 		return -ERANGE;
 
 	cell->vtd.pg_structs.root_paging = vtd_paging;
-	cell->vtd.pg_structs.root_table = page_alloc(&mem_pool, 1);
+	cell->vtd.pg_structs.root_table =
+		page_budget_alloc(&mem_pool, &cell->page_budget, 1,
+				  PAGE_USAGE_IOMMU_PT);
+	cell->vtd.pg_structs.usage = PAGE_USAGE_IOMMU_PT;
+	cell->vtd.pg_structs.budget = &cell->page_budget;
 	if (!cell->vtd.pg_structs.root_table)
 		return -ENOMEM;
 
-	for (n = 0; n < config->num_memory_regions; n++, mem++) {
-		err = vtd_map_memory_region(cell, mem);
-		if (err)
-			/* FIXME: release vtd.pg_structs.root_table */
-			return err;
-	}
+	return 0;
+}
 
-	for (n = 0; n < config->num_pci_devices; n++)
+int vtd_cell_assign_devices(struct cell *cell)
+{
+	const struct jailhouse_pci_device *dev =
+		jailhouse_cell_pci_devices(cell->config);
+	void *reg_base = dmar_reg_base;
+	int n;
+
+	// HACK for QEMU
+	if (dmar_units == 0)
+		return 0;
+
+	for (n = 0; n < cell->config->num_pci_devices; n++)
 		if (!vtd_add_device_to_cell(cell, &dev[n]))
 			/* FIXME: release vtd.pg_structs.root_table,
 			 * revert device additions*/
@@ -434,8 +439,24 @@ void vtd_root_cell_shrink(struct jailhouse_cell_desc *config)
 	vtd_flush_domain_caches(root_cell.id);
 }
 
-int vtd_map_memory_region(struct cell *cell,
-			  const struct jailhouse_memory *mem)
+/*
+ * Returns the guest-physical range covered by one entry of the root table, or
+ * 0 if it can map pages itself.
+ */
+unsigned long vtd_root_entry_span(void)
+{
+	if (vtd_paging[0].page_size > 0)
+		return 0;
+	return 1UL << (12 + 9 * (dmar_pt_levels - 1));
+}
+
+/*
+ * Maps the memory region into the given VT-d structures of the cell, which may
+ * also be rooted below the top level.
+ */
+int vtd_map_memory_range(struct cell *cell,
+			 const struct paging_structures *pg_structs,
+			 const struct jailhouse_memory *mem)
 {
 	u32 flags = 0;
 
@@ -451,9 +472,14 @@ int vtd_map_memory_region(struct cell *cell,
 	if (mem->flags & JAILHOUSE_MEM_WRITE)
 		flags |= VTD_PAGE_WRITE;
 
-	return page_map_create(&cell->vtd.pg_structs, mem->phys_start,
-			       mem->size, mem->virt_start, flags,
-			       PAGE_MAP_COHERENT);
+	return page_map_create(pg_structs, mem->phys_start, mem->size,
+			       mem->virt_start, flags, PAGE_MAP_COHERENT);
+}
+
+int vtd_map_memory_region(struct cell *cell,
+			  const struct jailhouse_memory *mem)
+{
+	return vtd_map_memory_range(cell, &cell->vtd.pg_structs, mem);
 }
 
 int vtd_unmap_memory_region(struct cell *cell,
@@ -486,7 +512,7 @@ vtd_return_device_to_root_cell(const struct jailhouse_pci_device *dev)
 	return true;
 }
 
-void vtd_cell_exit(struct cell *cell)
+void vtd_cell_release_devices(struct cell *cell)
 {
 	const struct jailhouse_pci_device *dev =
 		jailhouse_cell_pci_devices(cell->config);
@@ -501,8 +527,21 @@ void vtd_cell_exit(struct cell *cell)
 
 	vtd_flush_domain_caches(cell->id);
 	vtd_flush_domain_caches(root_cell.id);
+}
+
+void vtd_cell_flush_caches(struct cell *cell)
+{
+	// HACK for QEMU
+	if (dmar_units == 0)
+		return;
 
-	page_free(&mem_pool, cell->vtd.pg_structs.root_table, 1);
+	vtd_flush_domain_caches(cell->id);
+}
+
+void vtd_cell_exit(struct cell *cell)
+{
+	page_budget_free(&mem_pool, &cell->page_budget,
+			 cell->vtd.pg_structs.root_table, 1);
 }
 
 void vtd_shutdown(void)
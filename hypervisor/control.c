@@ -21,10 +21,56 @@
 
 struct jailhouse_system *system_config;
 
+/* Upper limit of cell IDs, thus of concurrently existing cells. */
+#ifndef CONFIG_MAX_CELLS
+#define CONFIG_MAX_CELLS	64
+#endif
+
+/* TSC cycles a cell has to answer a shutdown request, 0 waits forever */
+#ifndef CONFIG_SHUTDOWN_TIMEOUT_CYCLES
+#define CONFIG_SHUTDOWN_TIMEOUT_CYCLES	4000000000UL
+#endif
+
+#define CELL_NAME_HASH_SIZE	64
+
+/* states of a shutdown request posted to a cell */
+#define SHUTDOWN_REQ_NONE	0
+#define SHUTDOWN_REQ_PENDING	1
+#define SHUTDOWN_REQ_AGREED	2
+
+#define MAX_ATTACHED_MEM	(PAGE_SIZE / sizeof(struct jailhouse_memory))
+
+/*
+ * Entry of the per-cell memory region index. Entries are sorted by physical
+ * start address, max_end is the highest end address of all entries up to and
+ * including this one. This allows to find overlapping regions by binary
+ * search even if the regions of a cell overlap each other.
+ */
+struct mem_index_entry {
+	const struct jailhouse_memory *mem;
+	unsigned long max_end;
+};
+
 static DEFINE_SPINLOCK(shutdown_lock);
 static unsigned int num_cells = 1;
 
-#define for_each_cell(c)	for (c = &root_cell; c; c = c->next)
+/*
+ * Cell management operations suspend the root cell. A root CPU spinning on a
+ * lock inside a hypercall could not be stopped, so concurrent operations are
+ * rejected via a busy flag instead of waiting for each other.
+ */
+static DEFINE_SPINLOCK(cell_mgmt_lock);
+static bool cell_mgmt_busy;
+
+static unsigned long cell_ids[(CONFIG_MAX_CELLS + BITS_PER_LONG - 1) /
+			      BITS_PER_LONG];
+static struct cell *cell_table[CONFIG_MAX_CELLS];
+static struct cell *cell_name_hash[CELL_NAME_HASH_SIZE];
+
+/* The root cell always holds ID 0 and is thus visited first. */
+#define for_each_cell(c)	for (c = &root_cell; c; c = next_cell(c))
+#define for_each_non_root_cell(c)	\
+	for (c = next_cell(&root_cell); c; c = next_cell(c))
 
 unsigned int next_cpu(unsigned int cpu, struct cpu_set *cpu_set, int exception)
 {
@@ -53,27 +99,230 @@ static void cell_suspend(struct cell *cell, struct per_cpu *cpu_data)
 	printk("Suspended cell \"%s\"\n", cell->config->name);
 }
 
-static void cell_resume(struct per_cpu *cpu_data)
+static void cell_resume(struct cell *cell, struct per_cpu *cpu_data)
 {
 	unsigned int cpu;
 
-	for_each_cpu_except(cpu, cpu_data->cell->cpu_set, cpu_data->cpu_id)
+	for_each_cpu_except(cpu, cell->cpu_set, cpu_data->cpu_id)
 		arch_resume_cpu(cpu);
 }
 
-static unsigned int get_free_cell_id(void)
+/* Hands a stopped CPU over to the given cell. */
+static void cell_assign_cpu(struct cell *cell, unsigned int cpu)
 {
-	unsigned int id = 0;
-	struct cell *cell;
+	struct per_cpu *cpu_data = per_cpu(cpu);
 
-retry:
-	for_each_cell(cell)
-		if (cell->id == id) {
-			id++;
-			goto retry;
+	cpu_data->cell = cell;
+	cpu_data->failed = false;
+	/* statistics are accounted to the cell owning the CPU */
+	memset(cpu_data->stats, 0, sizeof(cpu_data->stats));
+}
+
+static bool cell_mgmt_enter(void)
+{
+	bool busy;
+
+	spin_lock(&cell_mgmt_lock);
+	busy = cell_mgmt_busy;
+	cell_mgmt_busy = true;
+	spin_unlock(&cell_mgmt_lock);
+
+	return !busy;
+}
+
+static void cell_mgmt_leave(void)
+{
+	spin_lock(&cell_mgmt_lock);
+	cell_mgmt_busy = false;
+	spin_unlock(&cell_mgmt_lock);
+}
+
+static struct cell *next_cell(const struct cell *cell)
+{
+	unsigned int id;
+
+	for (id = cell->id + 1; id < CONFIG_MAX_CELLS; id++)
+		if (cell_table[id])
+			return cell_table[id];
+	return NULL;
+}
+
+static struct cell *cell_lookup(unsigned long id)
+{
+	return id < CONFIG_MAX_CELLS ? cell_table[id] : NULL;
+}
+
+static unsigned int cell_name_hash_index(const char *name)
+{
+	unsigned int hash = 0;
+
+	while (*name)
+		hash = hash * 31 + *name++;
+	return hash % CELL_NAME_HASH_SIZE;
+}
+
+static struct cell *cell_lookup_name(const char *name)
+{
+	struct cell *cell = cell_name_hash[cell_name_hash_index(name)];
+
+	while (cell && strcmp(cell->config->name, name) != 0)
+		cell = cell->name_next;
+	return cell;
+}
+
+static int alloc_cell_id(void)
+{
+	unsigned int n, id;
+
+	for (n = 0; n < sizeof(cell_ids) / sizeof(cell_ids[0]); n++)
+		if (cell_ids[n] != ~0UL) {
+			id = n * BITS_PER_LONG + ffzl(cell_ids[n]);
+			if (id >= CONFIG_MAX_CELLS)
+				break;
+			set_bit(id, cell_ids);
+			return id;
 		}
+	return -ERANGE;
+}
+
+/*
+ * The registry is read locklessly by hypercalls of the root cell. It must
+ * only be modified while the root cell is suspended.
+ */
+void cell_register(struct cell *cell)
+{
+	struct cell **bucket =
+		&cell_name_hash[cell_name_hash_index(cell->config->name)];
+
+	cell_table[cell->id] = cell;
+	cell->name_next = *bucket;
+	*bucket = cell;
+}
+
+static void cell_unregister(struct cell *cell)
+{
+	struct cell **link =
+		&cell_name_hash[cell_name_hash_index(cell->config->name)];
+
+	while (*link != cell)
+		link = &(*link)->name_next;
+	*link = cell->name_next;
+
+	cell_table[cell->id] = NULL;
+}
+
+/* Number of memory regions from the configuration plus attached ones. */
+static unsigned int cell_num_mem_regions(const struct cell *cell)
+{
+	return cell->config->num_memory_regions + cell->num_attached_mem;
+}
+
+static const struct jailhouse_memory *
+cell_mem_region(const struct cell *cell, unsigned int n)
+{
+	if (n < cell->config->num_memory_regions)
+		return &jailhouse_cell_mem_regions(cell->config)[n];
+	return &cell->attached_mem[n - cell->config->num_memory_regions];
+}
+
+static unsigned int mem_index_pages(unsigned int entries)
+{
+	return PAGE_ALIGN(entries * sizeof(struct mem_index_entry)) /
+		PAGE_SIZE;
+}
 
-	return id;
+static void mem_index_free(struct cell *cell)
+{
+	if (cell->mem_index)
+		page_free(&mem_pool, cell->mem_index,
+			  mem_index_pages(cell->mem_index_capacity));
+}
+
+/*
+ * (Re-)index all regions backed by physical memory, i.e. all but the comm
+ * region. The existing index is rebuilt in place if it is large enough, so
+ * this cannot fail if the number of regions did not grow.
+ */
+static int mem_index_init(struct cell *cell)
+{
+	const struct jailhouse_memory *mem;
+	struct mem_index_entry *index = cell->mem_index;
+	unsigned int n, entries = 0;
+	unsigned long end;
+	int pos;
+
+	for (n = 0; n < cell_num_mem_regions(cell); n++)
+		if (!(cell_mem_region(cell, n)->flags &
+		      JAILHOUSE_MEM_COMM_REGION))
+			entries++;
+
+	if (entries > cell->mem_index_capacity) {
+		index = page_alloc(&mem_pool, mem_index_pages(entries),
+				   PAGE_USAGE_CELL);
+		if (!index)
+			return -ENOMEM;
+		mem_index_free(cell);
+		cell->mem_index = index;
+		cell->mem_index_capacity = mem_index_pages(entries) *
+			PAGE_SIZE / sizeof(struct mem_index_entry);
+	}
+
+	/* insertion sort, configurations are usually ordered already */
+	for (n = 0, entries = 0; n < cell_num_mem_regions(cell); n++) {
+		mem = cell_mem_region(cell, n);
+		if (mem->flags & JAILHOUSE_MEM_COMM_REGION)
+			continue;
+		for (pos = (int)entries - 1;
+		     pos >= 0 && index[pos].mem->phys_start > mem->phys_start;
+		     pos--)
+			index[pos + 1] = index[pos];
+		index[pos + 1].mem = mem;
+		entries++;
+	}
+
+	for (n = 0, end = 0; n < entries; n++) {
+		if (index[n].mem->phys_start + index[n].mem->size > end)
+			end = index[n].mem->phys_start + index[n].mem->size;
+		index[n].max_end = end;
+	}
+
+	cell->mem_index_entries = entries;
+	return 0;
+}
+
+/*
+ * Returns the position of the first index entry that may end behind start.
+ * No entry before it overlaps with a range beginning at start.
+ */
+static unsigned int mem_index_lookup(const struct cell *cell,
+				     unsigned long start)
+{
+	unsigned int low = 0, high = cell->mem_index_entries, mid;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (cell->mem_index[mid].max_end > start)
+			high = mid;
+		else
+			low = mid + 1;
+	}
+	return low;
+}
+
+static bool mem_index_overlaps(const struct cell *cell,
+			       const struct jailhouse_memory *mem)
+{
+	unsigned int pos = mem_index_lookup(cell, mem->phys_start);
+
+	return pos < cell->mem_index_entries &&
+		cell->mem_index[pos].mem->phys_start <
+		mem->phys_start + mem->size;
+}
+
+static void destroy_cpu_set(struct cell *cell)
+{
+	if (cell->cpu_set != &cell->small_cpu_set)
+		page_free(&mem_pool, cell->cpu_set, 1);
 }
 
 int cell_init(struct cell *cell, bool copy_cpu_set)
@@ -82,15 +331,29 @@ int cell_init(struct cell *cell, bool copy_cpu_set)
 		jailhouse_cell_cpu_set(cell->config);
 	unsigned long cpu_set_size = cell->config->cpu_set_size;
 	struct cpu_set *cpu_set;
-
-	cell->id = get_free_cell_id();
+	int id, err;
 
 	if (cpu_set_size > PAGE_SIZE)
 		return -EINVAL;
-	else if (cpu_set_size > sizeof(cell->small_cpu_set.bitmap)) {
-		cpu_set = page_alloc(&mem_pool, 1);
-		if (!cpu_set)
+
+	id = alloc_cell_id();
+	if (id < 0)
+		return id;
+	cell->id = id;
+
+	err = mem_index_init(cell);
+	if (err) {
+		clear_bit(id, cell_ids);
+		return err;
+	}
+
+	if (cpu_set_size > sizeof(cell->small_cpu_set.bitmap)) {
+		cpu_set = page_alloc(&mem_pool, 1, PAGE_USAGE_CPU_SET);
+		if (!cpu_set) {
+			mem_index_free(cell);
+			clear_bit(id, cell_ids);
 			return -ENOMEM;
+		}
 		cpu_set->max_cpu_id =
 			((PAGE_SIZE - sizeof(unsigned long)) * 8) - 1;
 	} else {
@@ -105,63 +368,86 @@ int cell_init(struct cell *cell, bool copy_cpu_set)
 	return 0;
 }
 
-static void destroy_cpu_set(struct cell *cell)
+static void cell_exit(struct cell *cell)
 {
-	if (cell->cpu_set != &cell->small_cpu_set)
-		page_free(&mem_pool, cell->cpu_set, 1);
+	page_free(&mem_pool, cell->snapshot, cell->snapshot_pages);
+	page_free(&mem_pool, cell->attached_mem, 1);
+	destroy_cpu_set(cell);
+	mem_index_free(cell);
+	clear_bit(cell->id, cell_ids);
 }
 
-int check_mem_regions(const struct jailhouse_cell_desc *config)
+/* Non-root cells must not share physical memory. */
+static bool cell_mem_in_use(const struct cell *cell)
 {
 	const struct jailhouse_memory *mem =
-		jailhouse_cell_mem_regions(config);
+		jailhouse_cell_mem_regions(cell->config);
+	struct cell *other;
 	unsigned int n;
 
-	for (n = 0; n < config->num_memory_regions; n++, mem++) {
-		if (mem->phys_start & ~PAGE_MASK ||
-		    mem->virt_start & ~PAGE_MASK ||
-		    mem->size & ~PAGE_MASK ||
-		    mem->flags & ~JAILHOUSE_MEM_VALID_FLAGS) {
-			printk("FATAL: Invalid memory bar (%p, %p, %p, %x)\n",
-			       mem->phys_start, mem->virt_start, mem->size,
-			       mem->flags);
-			return -EINVAL;
-		}
+	for (n = 0; n < cell->config->num_memory_regions; n++, mem++) {
+		if (mem->flags & JAILHOUSE_MEM_COMM_REGION)
+			continue;
+		for_each_non_root_cell(other)
+			if (other != cell && mem_index_overlaps(other, mem))
+				return true;
+	}
+	return false;
+}
+
+static int check_mem_region(const struct jailhouse_memory *mem)
+{
+	if (mem->phys_start & ~PAGE_MASK ||
+	    mem->virt_start & ~PAGE_MASK ||
+	    mem->size & ~PAGE_MASK ||
+	    mem->flags & ~JAILHOUSE_MEM_VALID_FLAGS ||
+	    (mem->flags & JAILHOUSE_MEM_COMM_REGION &&
+	     mem->flags & JAILHOUSE_MEM_SNAPSHOT)) {
+		printk("FATAL: Invalid memory bar (%p, %p, %p, %x)\n",
+		       mem->phys_start, mem->virt_start, mem->size,
+		       mem->flags);
+		return -EINVAL;
 	}
 	return 0;
 }
 
-static bool address_in_region(unsigned long addr,
-			      const struct jailhouse_memory *region)
+int check_mem_regions(const struct jailhouse_cell_desc *config)
 {
-	return addr >= region->phys_start &&
-	       addr < (region->phys_start + region->size);
+	const struct jailhouse_memory *mem =
+		jailhouse_cell_mem_regions(config);
+	unsigned int n;
+	int err;
+
+	for (n = 0; n < config->num_memory_regions; n++, mem++) {
+		err = check_mem_region(mem);
+		if (err)
+			return err;
+	}
+	return 0;
 }
 
 static void remap_to_root_cell(const struct jailhouse_memory *mem)
 {
-	const struct jailhouse_memory *root_mem =
-		jailhouse_cell_mem_regions(root_cell.config);
+	unsigned long mem_end = mem->phys_start + mem->size;
+	const struct jailhouse_memory *root_mem;
 	struct jailhouse_memory overlap;
-	unsigned int n;
-
-	for (n = 0; n < root_cell.config->num_memory_regions;
-	     n++, root_mem++) {
-		if (address_in_region(mem->phys_start, root_mem)) {
-			overlap.phys_start = mem->phys_start;
-			overlap.size = root_mem->size -
-				(overlap.phys_start - root_mem->phys_start);
-			if (overlap.size > mem->size)
-				overlap.size = mem->size;
-		} else if (address_in_region(root_mem->phys_start, mem)) {
-			overlap.phys_start = root_mem->phys_start;
-			overlap.size = mem->size -
-				(overlap.phys_start - mem->phys_start);
-			if (overlap.size > root_mem->size)
-				overlap.size = root_mem->size;
-		} else
+	unsigned long end;
+	unsigned int pos;
+
+	/* visit the root regions intersecting with mem in address order */
+	for (pos = mem_index_lookup(&root_cell, mem->phys_start);
+	     pos < root_cell.mem_index_entries &&
+	     root_cell.mem_index[pos].mem->phys_start < mem_end;
+	     pos++) {
+		root_mem = root_cell.mem_index[pos].mem;
+		end = root_mem->phys_start + root_mem->size;
+		if (end <= mem->phys_start)
 			continue;
 
+		overlap.phys_start = root_mem->phys_start > mem->phys_start ?
+			root_mem->phys_start : mem->phys_start;
+		overlap.size = (end < mem_end ? end : mem_end) -
+			overlap.phys_start;
 		overlap.virt_start = root_mem->virt_start +
 			overlap.phys_start - root_mem->phys_start;
 		overlap.flags = root_mem->flags;
@@ -172,24 +458,109 @@ static void remap_to_root_cell(const struct jailhouse_memory *mem)
 	}
 }
 
+/*
+ * Copies the snapshot regions of a cell into its snapshot or, if restore is
+ * set, back into the cell's memory. Uses the temporary mapping of the
+ * calling CPU.
+ */
+static int snapshot_copy(struct per_cpu *cpu_data, struct cell *cell,
+			 bool restore)
+{
+	unsigned long mapping_addr = TEMPORARY_MAPPING_CPU_BASE(cpu_data);
+	const struct jailhouse_memory *mem =
+		jailhouse_cell_mem_regions(cell->config);
+	unsigned long offs, size;
+	void *snapshot = cell->snapshot;
+	unsigned int n;
+	int err;
+
+	for (n = 0; n < cell->config->num_memory_regions; n++, mem++) {
+		if (!(mem->flags & JAILHOUSE_MEM_SNAPSHOT))
+			continue;
+		for (offs = 0; offs < mem->size; offs += size) {
+			size = mem->size - offs;
+			if (size > NUM_TEMPORARY_PAGES * PAGE_SIZE)
+				size = NUM_TEMPORARY_PAGES * PAGE_SIZE;
+
+			err = page_map_create(&hv_paging_structs,
+					      mem->phys_start + offs, size,
+					      mapping_addr, PAGE_DEFAULT_FLAGS,
+					      PAGE_MAP_NON_COHERENT);
+			if (err)
+				return err;
+
+			if (restore)
+				memcpy((void *)mapping_addr, snapshot, size);
+			else
+				memcpy(snapshot, (void *)mapping_addr, size);
+			snapshot += size;
+		}
+	}
+	return 0;
+}
+
+static int snapshot_create(struct per_cpu *cpu_data, struct cell *cell)
+{
+	const struct jailhouse_memory *mem =
+		jailhouse_cell_mem_regions(cell->config);
+	unsigned long pages = 0;
+	unsigned int n;
+	int err;
+
+	for (n = 0; n < cell->config->num_memory_regions; n++, mem++)
+		if (mem->flags & JAILHOUSE_MEM_SNAPSHOT)
+			pages += mem->size / PAGE_SIZE;
+	if (pages == 0)
+		return 0;
+
+	cell->snapshot = page_alloc(&mem_pool, pages, PAGE_USAGE_CELL);
+	if (!cell->snapshot)
+		return -ENOMEM;
+	cell->snapshot_pages = pages;
+
+	err = snapshot_copy(cpu_data, cell, false);
+	if (err) {
+		page_free(&mem_pool, cell->snapshot, pages);
+		cell->snapshot = NULL;
+	}
+	return err;
+}
+
+/* Release the cell's guest mappings while the root cell may be running. */
+static void cell_destroy_mappings(struct per_cpu *cpu_data, struct cell *cell)
+{
+	unsigned int n;
+
+	for (n = 0; n < cell_num_mem_regions(cell); n++)
+		/*
+		 * This cannot fail. The region was mapped as a whole before,
+		 * thus no hugepages need to be broken up to unmap it.
+		 */
+		arch_unmap_memory_region(cell, cell_mem_region(cell, n));
+
+	arch_cell_destroy(cpu_data, cell);
+}
+
 int cell_create(struct per_cpu *cpu_data, unsigned long config_address)
 {
 	unsigned long mapping_addr = TEMPORARY_MAPPING_CPU_BASE(cpu_data);
 	unsigned long cfg_page_offs = config_address & ~PAGE_MASK;
-	unsigned long cfg_header_size, cfg_total_size;
+	unsigned long cfg_header_size, cfg_total_size, root_remap_pages;
+	unsigned long start = get_cycles(), build_start, commit_start;
 	const struct jailhouse_memory *mem;
 	struct jailhouse_cell_desc *cfg;
 	unsigned int cell_pages, cpu, n;
 	struct cpu_set *shrinking_set;
 	struct jailhouse_memory tmp;
-	struct cell *cell, *last;
+	struct cell *cell;
 	int err;
 
 	/* We do not support creation over non-root cells. */
 	if (cpu_data->cell != &root_cell)
 		return -EPERM;
 
-	cell_suspend(&root_cell, cpu_data);
+	if (!cell_mgmt_enter())
+		return -EBUSY;
 
 	cfg_header_size = (config_address & ~PAGE_MASK) +
 		sizeof(struct jailhouse_cell_desc);
@@ -198,36 +569,35 @@ int cell_create(struct per_cpu *cpu_data, unsigned long config_address)
 			      cfg_header_size, mapping_addr,
 			      PAGE_READONLY_FLAGS, PAGE_MAP_NON_COHERENT);
 	if (err)
-		goto err_resume;
+		goto err_leave;
 
 	cfg = (struct jailhouse_cell_desc *)(mapping_addr + cfg_page_offs);
 	cfg_total_size = jailhouse_cell_config_size(cfg);
 	if (cfg_total_size + cfg_page_offs > NUM_TEMPORARY_PAGES * PAGE_SIZE) {
 		err = -E2BIG;
-		goto err_resume;
+		goto err_leave;
 	}
 
-	for_each_cell(cell)
-		if (strcmp(cell->config->name, cfg->name) == 0) {
-			err = -EEXIST;
-			goto err_resume;
-		}
+	if (cell_lookup_name(cfg->name)) {
+		err = -EEXIST;
+		goto err_leave;
+	}
 
 	err = page_map_create(&hv_paging_structs, config_address & PAGE_MASK,
 			      cfg_total_size + cfg_page_offs, mapping_addr,
 			      PAGE_READONLY_FLAGS, PAGE_MAP_NON_COHERENT);
 	if (err)
-		goto err_resume;
+		goto err_leave;
 
 	err = check_mem_regions(cfg);
 	if (err)
-		goto err_resume;
+		goto err_leave;
 
 	cell_pages = PAGE_ALIGN(sizeof(*cell) + cfg_total_size) / PAGE_SIZE;
-	cell = page_alloc(&mem_pool, cell_pages);
+	cell = page_alloc(&mem_pool, cell_pages, PAGE_USAGE_CELL);
 	if (!cell) {
 		err = -ENOMEM;
-		goto err_resume;
+		goto err_leave;
 	}
 
 	cell->data_pages = cell_pages;
@@ -238,11 +608,32 @@ int cell_create(struct per_cpu *cpu_data, unsigned long config_address)
 	if (err)
 		goto err_free_cell;
 
+	if (cell_mem_in_use(cell)) {
+		err = -EBUSY;
+		goto err_cell_exit;
+	}
+
+	/*
+	 * Reserve what the page tables of the new cell and the remapping of
+	 * the root cell can take so that neither fails for lack of memory.
+	 */
+	cell->page_budget.strict = true;
+	err = page_budget_grow(&mem_pool, &cell->page_budget,
+			       arch_cell_page_budget(cell->config));
+	if (err)
+		goto err_cell_exit;
+	root_remap_pages =
+		arch_root_cell_remap_pages(cell->config->num_memory_regions);
+	err = page_budget_grow(&mem_pool, &root_cell.page_budget,
+			       root_remap_pages);
+	if (err)
+		goto err_release_budget;
+
 	/* don't assign the CPU we are currently running on */
 	if (cpu_data->cpu_id <= cell->cpu_set->max_cpu_id &&
 	    test_bit(cpu_data->cpu_id, cell->cpu_set->bitmap)) {
 		err = -EBUSY;
-		goto err_free_cpu_set;
+		goto err_release_root_budget;
 	}
 
 	shrinking_set = cpu_data->cell->cpu_set;
@@ -250,14 +641,32 @@ int cell_create(struct per_cpu *cpu_data, unsigned long config_address)
 	/* shrinking set must be super-set of new cell's cpu set */
 	if (shrinking_set->max_cpu_id < cell->cpu_set->max_cpu_id) {
 		err = -EBUSY;
-		goto err_free_cpu_set;
+		goto err_release_root_budget;
 	}
 	for_each_cpu(cpu, cell->cpu_set)
 		if (!test_bit(cpu, shrinking_set->bitmap)) {
 			err = -EBUSY;
-			goto err_free_cpu_set;
+			goto err_release_root_budget;
 		}
 
+	/*
+	 * The images of the cell were loaded by the root cell before this
+	 * call, capture them for later restarts.
+	 */
+	err = snapshot_create(cpu_data, cell);
+	if (err)
+		goto err_release_root_budget;
+
+	/* build the page tables of the new cell while the root cell runs */
+	build_start = get_cycles();
+	err = arch_cell_create(cpu_data, cell);
+	if (err)
+		goto err_release_root_budget;
+
+	/* commit phase, the root cell has to be stopped from here on */
+	commit_start = get_cycles();
+	cell_suspend(&root_cell, cpu_data);
+
 	for_each_cpu(cpu, cell->cpu_set)
 		clear_bit(cpu, shrinking_set->bitmap);
 
@@ -282,104 +691,142 @@ int cell_create(struct per_cpu *cpu_data, unsigned long config_address)
 				goto err_restore_root;
 		}
 
-	err = arch_cell_create(cpu_data, cell);
+	err = arch_cell_commit(cpu_data, cell);
 	if (err)
 		goto err_restore_root;
 
-	last = &root_cell;
-	while (last->next)
-		last = last->next;
-	last->next = cell;
+	cell_register(cell);
 	num_cells++;
 
 	/* update cell references and clean up before releasing the cpus of
 	 * the new cell */
-	for_each_cpu(cpu, cell->cpu_set)
-		per_cpu(cpu)->cell = cell;
+	for_each_cpu(cpu, cell->cpu_set) {
+		cell_assign_cpu(cell, cpu);
+		arch_reset_cpu(cpu);
+	}
+
+	cell_resume(&root_cell, cpu_data);
 
 	printk("Created cell \"%s\"\n", cell->config->name);
+	printk("Creation cycles: prepare %lu, build %lu, commit %lu\n",
+	       build_start - start, commit_start - build_start,
+	       get_cycles() - commit_start);
 
 	page_map_dump_stats("after cell creation");
 
-	for_each_cpu(cpu, cell->cpu_set) {
-		per_cpu(cpu)->failed = false;
-		arch_reset_cpu(cpu);
-	}
-
-	cell_resume(cpu_data);
+	cell_mgmt_leave();
 
 	return cell->id;
 
 err_restore_root:
 	mem = jailhouse_cell_mem_regions(cell->config);
 	for (n = 0; n < cell->config->num_memory_regions; n++, mem++)
-		remap_to_root_cell(mem);
+		if (!(mem->flags & JAILHOUSE_MEM_COMM_REGION))
+			remap_to_root_cell(mem);
 	for_each_cpu(cpu, cell->cpu_set)
 		set_bit(cpu, shrinking_set->bitmap);
-err_free_cpu_set:
-	destroy_cpu_set(cell);
+	cell_resume(&root_cell, cpu_data);
+	cell_destroy_mappings(cpu_data, cell);
+err_release_root_budget:
+	page_budget_shrink(&mem_pool, &root_cell.page_budget, root_remap_pages);
+err_release_budget:
+	page_budget_shrink(&mem_pool, &cell->page_budget,
+			   cell->page_budget.pages);
+err_cell_exit:
+	cell_exit(cell);
 err_free_cell:
 	page_free(&mem_pool, cell, cell_pages);
-
-err_resume:
-	cell_resume(cpu_data);
+err_leave:
+	cell_mgmt_leave();
 
 	return err;
 }
 
-static bool cell_shutdown_ok(struct cell *cell)
+/*
+ * Posts a shutdown request to the cell on the first call and checks for its
+ * answer on subsequent ones, without waiting for it. Returns 0 if the cell
+ * agreed, is stopped or missed the deadline, -EPERM if it refused and -EAGAIN
+ * while the answer is pending. An agreement is kept until the operation that
+ * asked for it completes or gives up, so that retries of the operation do
+ * not ask again.
+ */
+static int cell_request_shutdown(struct cell *cell)
 {
 	volatile u32 *reply = &cell->comm_page.comm_region.reply_from_cell;
 	volatile u32 *cell_state = &cell->comm_page.comm_region.cell_state;
 
-	if (cell->config->flags & JAILHOUSE_CELL_UNMANAGED_EXIT)
-		return true;
+	if (cell->config->flags & JAILHOUSE_CELL_UNMANAGED_EXIT ||
+	    cell->shutdown_request == SHUTDOWN_REQ_AGREED)
+		return 0;
 
-	jailhouse_send_msg_to_cell(&cell->comm_page.comm_region,
-				   JAILHOUSE_MSG_SHUTDOWN_REQUESTED);
+	if (cell->shutdown_request == SHUTDOWN_REQ_NONE) {
+		jailhouse_send_msg_to_cell(&cell->comm_page.comm_region,
+					   JAILHOUSE_MSG_SHUTDOWN_REQUESTED);
+		cell->shutdown_request = SHUTDOWN_REQ_PENDING;
+		cell->shutdown_deadline =
+			get_cycles() + CONFIG_SHUTDOWN_TIMEOUT_CYCLES;
+	}
 
-	while (*reply != JAILHOUSE_MSG_SHUTDOWN_DENIED) {
-		if (*reply == JAILHOUSE_MSG_SHUTDOWN_OK ||
-		    *cell_state == JAILHOUSE_CELL_SHUT_DOWN ||
-		    *cell_state == JAILHOUSE_CELL_FAILED)
-			return true;
-		cpu_relax();
+	if (*reply == JAILHOUSE_MSG_SHUTDOWN_DENIED) {
+		cell->shutdown_request = SHUTDOWN_REQ_NONE;
+		return -EPERM;
+	} else if (*reply == JAILHOUSE_MSG_SHUTDOWN_OK ||
+		   *cell_state == JAILHOUSE_CELL_SHUT_DOWN ||
+		   *cell_state == JAILHOUSE_CELL_FAILED) {
+		cell->shutdown_request = SHUTDOWN_REQ_AGREED;
+		return 0;
+	} else if (CONFIG_SHUTDOWN_TIMEOUT_CYCLES != 0 &&
+		   (long)(get_cycles() - cell->shutdown_deadline) >= 0) {
+		printk("WARNING: Cell \"%s\" did not answer shutdown request\n",
+		       cell->config->name);
+		cell->shutdown_request = SHUTDOWN_REQ_AGREED;
+		return 0;
 	}
-	return false;
+	return -EAGAIN;
+}
+
+/*
+ * Forgets the shutdown request of a cell when the operation that posted it is
+ * aborted or the cell is restarted. A later request starts over with a new
+ * deadline.
+ */
+static void cell_clear_shutdown_request(struct cell *cell)
+{
+	cell->shutdown_request = SHUTDOWN_REQ_NONE;
 }
 
 int cell_destroy(struct per_cpu *cpu_data, unsigned long id)
 {
+	unsigned long start, release_start, teardown_start;
 	const struct jailhouse_memory *mem;
-	struct cell *cell, *previous;
 	unsigned int cpu, n;
+	struct cell *cell;
 	int err = 0;
 
 	/* We do not support destruction over non-root cells. */
 	if (cpu_data->cell != &root_cell)
 		return -EPERM;
 
-	cell_suspend(&root_cell, cpu_data);
+	if (!cell_mgmt_enter())
+		return -EBUSY;
 
-	for_each_cell(cell)
-		if (cell->id == id)
-			break;
+	cell = cell_lookup(id);
 	if (!cell) {
 		err = -ENOENT;
-		goto resume_out;
+		goto out;
 	}
 
 	/* root cell cannot be destroyed */
 	if (cell == &root_cell) {
 		err = -EINVAL;
-		goto resume_out;
+		goto out;
 	}
 
-	if (!cell_shutdown_ok(cell)) {
-		err = -EPERM;
-		goto resume_out;
-	}
+	err = cell_request_shutdown(cell);
+	if (err)
+		goto out;
 
+	start = get_cycles();
 	cell_suspend(cell, cpu_data);
 
 	printk("Closing cell \"%s\"\n", cell->config->name);
@@ -387,36 +834,398 @@ int cell_destroy(struct per_cpu *cpu_data, unsigned long id)
 	for_each_cpu(cpu, cell->cpu_set) {
 		printk(" Parking CPU %d\n", cpu);
 		arch_park_cpu(cpu);
+	}
+
+	/* release phase, hand CPUs, memory and devices back to the root cell */
+	release_start = get_cycles();
+	cell_suspend(&root_cell, cpu_data);
 
+	for_each_cpu(cpu, cell->cpu_set) {
 		set_bit(cpu, root_cell.cpu_set->bitmap);
-		per_cpu(cpu)->cell = &root_cell;
-		per_cpu(cpu)->failed = false;
+		cell_assign_cpu(&root_cell, cpu);
 	}
 
-	mem = jailhouse_cell_mem_regions(cell->config);
-	for (n = 0; n < cell->config->num_memory_regions; n++, mem++) {
-		/*
-		 * This cannot fail. The region was mapped as a whole before,
-		 * thus no hugepages need to be broken up to unmap it.
-		 */
-		arch_unmap_memory_region(cell, mem);
+	for (n = 0; n < cell_num_mem_regions(cell); n++) {
+		mem = cell_mem_region(cell, n);
 		if (!(mem->flags & JAILHOUSE_MEM_COMM_REGION))
 			remap_to_root_cell(mem);
 	}
 
-	arch_cell_destroy(cpu_data, cell);
+	arch_cell_release(cpu_data, cell);
 
-	previous = &root_cell;
-	while (previous->next != cell)
-		previous = previous->next;
-	previous->next = cell->next;
+	cell_unregister(cell);
 	num_cells--;
 
+	cell_resume(&root_cell, cpu_data);
+
+	/* the cell is unreachable now, tear it down while the root runs */
+	teardown_start = get_cycles();
+	cell_destroy_mappings(cpu_data, cell);
+
+	page_budget_shrink(&mem_pool, &root_cell.page_budget,
+			   arch_root_cell_remap_pages(
+				cell_num_mem_regions(cell)));
+	page_budget_shrink(&mem_pool, &cell->page_budget,
+			   cell->page_budget.pages);
+
+	cell_exit(cell);
+
 	page_free(&mem_pool, cell, cell->data_pages);
+
+	printk("Destruction cycles: park %lu, release %lu, teardown %lu\n",
+	       release_start - start, teardown_start - release_start,
+	       get_cycles() - teardown_start);
 	page_map_dump_stats("after cell destruction");
 
-resume_out:
-	cell_resume(cpu_data);
+	/* scrub the released pages while the root cell is running again */
+	page_pool_scrub(&mem_pool);
+
+out:
+	cell_mgmt_leave();
+
+	return err;
+}
+
+int cell_start(struct per_cpu *cpu_data, unsigned long id,
+	       unsigned long flags)
+{
+	unsigned int cpu;
+	struct cell *cell;
+	int err = 0;
+
+	if (cpu_data->cell != &root_cell)
+		return -EPERM;
+
+	if (flags & ~JAILHOUSE_CELL_START_RESTORE)
+		return -EINVAL;
+
+	if (!cell_mgmt_enter())
+		return -EBUSY;
+
+	cell = cell_lookup(id);
+	if (!cell) {
+		err = -ENOENT;
+		goto out;
+	}
+
+	/* root cell cannot be restarted */
+	if (cell == &root_cell ||
+	    (flags & JAILHOUSE_CELL_START_RESTORE && !cell->snapshot)) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	err = cell_request_shutdown(cell);
+	if (err)
+		goto out;
+
+	/* the cell keeps its resources, only its CPUs need to be stopped */
+	cell_suspend(cell, cpu_data);
+
+	if (flags & JAILHOUSE_CELL_START_RESTORE) {
+		err = snapshot_copy(cpu_data, cell, true);
+		if (err) {
+			/* leave the cell stopped rather than half restored */
+			cell->comm_page.comm_region.cell_state =
+				JAILHOUSE_CELL_FAILED;
+			for_each_cpu(cpu, cell->cpu_set)
+				arch_park_cpu(cpu);
+			cell_clear_shutdown_request(cell);
+			goto out;
+		}
+	}
+
+	memset(&cell->comm_page, 0, sizeof(cell->comm_page));
+	cell->comm_page.comm_region.cell_state = JAILHOUSE_CELL_RUNNING;
+	cell_clear_shutdown_request(cell);
+
+	for_each_cpu(cpu, cell->cpu_set) {
+		cell_assign_cpu(cell, cpu);
+		arch_reset_cpu(cpu);
+	}
+
+	printk("Started cell \"%s\"\n", cell->config->name);
+
+out:
+	cell_mgmt_leave();
+
+	return err;
+}
+
+static int read_mem_region(struct per_cpu *cpu_data, unsigned long address,
+			   struct jailhouse_memory *mem)
+{
+	unsigned long mapping_addr = TEMPORARY_MAPPING_CPU_BASE(cpu_data);
+	unsigned long offs = address & ~PAGE_MASK;
+	int err;
+
+	err = page_map_create(&hv_paging_structs, address & PAGE_MASK,
+			      offs + sizeof(*mem), mapping_addr,
+			      PAGE_READONLY_FLAGS, PAGE_MAP_NON_COHERENT);
+	if (err)
+		return err;
+
+	memcpy(mem, (void *)(mapping_addr + offs), sizeof(*mem));
+	return 0;
+}
+
+/*
+ * Maps a buffer the root cell passed for results. It must lie within a single
+ * page and within a memory region the root cell is allowed to write.
+ */
+static int map_root_buffer(struct per_cpu *cpu_data, unsigned long address,
+			   unsigned long size, void **buffer)
+{
+	unsigned long mapping_addr = TEMPORARY_MAPPING_CPU_BASE(cpu_data);
+	unsigned long offs = address & ~PAGE_MASK;
+	const struct jailhouse_memory *mem;
+	unsigned long phys;
+	unsigned int n;
+	int err;
+
+	if (offs + size > PAGE_SIZE)
+		return -EINVAL;
+
+	for (n = 0; n < cell_num_mem_regions(&root_cell); n++) {
+		mem = cell_mem_region(&root_cell, n);
+		if ((mem->flags & (JAILHOUSE_MEM_WRITE |
+				   JAILHOUSE_MEM_COMM_REGION)) ==
+		    JAILHOUSE_MEM_WRITE &&
+		    address >= mem->virt_start &&
+		    address + size <= mem->virt_start + mem->size)
+			break;
+	}
+	if (n == cell_num_mem_regions(&root_cell))
+		return -EINVAL;
+
+	/* regions handed over to other cells are no longer mapped */
+	phys = arch_page_map_gphys2phys(cpu_data, address);
+	if (phys == INVALID_PHYS_ADDR)
+		return -EINVAL;
+
+	err = page_map_create(&hv_paging_structs, phys & PAGE_MASK, PAGE_SIZE,
+			      mapping_addr, PAGE_DEFAULT_FLAGS,
+			      PAGE_MAP_NON_COHERENT);
+	if (err)
+		return err;
+
+	*buffer = (void *)(mapping_addr + offs);
+	return 0;
+}
+
+/*
+ * Helpers to change a single mapping of a running cell. The cell's CPUs are
+ * only stopped for the update and the invalidation of their caches.
+ */
+static int cell_map_region(struct per_cpu *cpu_data, struct cell *cell,
+			   const struct jailhouse_memory *mem)
+{
+	int err;
+
+	cell_suspend(cell, cpu_data);
+	err = arch_map_memory_region(cell, mem);
+	arch_flush_cell_caches(cpu_data, cell);
+	cell_resume(cell, cpu_data);
+
+	return err;
+}
+
+static int cell_unmap_region(struct per_cpu *cpu_data, struct cell *cell,
+			     const struct jailhouse_memory *mem)
+{
+	int err;
+
+	cell_suspend(cell, cpu_data);
+	err = arch_unmap_memory_region(cell, mem);
+	arch_flush_cell_caches(cpu_data, cell);
+	cell_resume(cell, cpu_data);
+
+	return err;
+}
+
+static void root_cell_remap_region(struct per_cpu *cpu_data,
+				   const struct jailhouse_memory *mem)
+{
+	cell_suspend(&root_cell, cpu_data);
+	remap_to_root_cell(mem);
+	arch_flush_cell_caches(cpu_data, &root_cell);
+	cell_resume(&root_cell, cpu_data);
+}
+
+int cell_mem_attach(struct per_cpu *cpu_data, unsigned long id,
+		    unsigned long mem_address)
+{
+	const struct jailhouse_memory *cell_mem;
+	struct jailhouse_memory mem, tmp;
+	unsigned long budget_pages;
+	struct cell *cell, *other;
+	unsigned int n;
+	int err;
+
+	if (cpu_data->cell != &root_cell)
+		return -EPERM;
+
+	if (!cell_mgmt_enter())
+		return -EBUSY;
+
+	cell = cell_lookup(id);
+	if (!cell) {
+		err = -ENOENT;
+		goto out;
+	}
+
+	/* the root cell holds all unassigned memory already */
+	if (cell == &root_cell) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	err = read_mem_region(cpu_data, mem_address, &mem);
+	if (err)
+		goto out;
+
+	err = check_mem_region(&mem);
+	if (err)
+		goto out;
+	if (mem.size == 0 ||
+	    mem.flags & (JAILHOUSE_MEM_COMM_REGION | JAILHOUSE_MEM_SNAPSHOT)) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	/* the guest range has to be unused by the cell */
+	for (n = 0; n < cell_num_mem_regions(cell); n++) {
+		cell_mem = cell_mem_region(cell, n);
+		if (mem.virt_start < cell_mem->virt_start + cell_mem->size &&
+		    cell_mem->virt_start < mem.virt_start + mem.size) {
+			err = -EINVAL;
+			goto out;
+		}
+	}
+
+	for_each_non_root_cell(other)
+		if (mem_index_overlaps(other, &mem)) {
+			err = -EBUSY;
+			goto out;
+		}
+
+	if (cell->num_attached_mem >= MAX_ATTACHED_MEM) {
+		err = -E2BIG;
+		goto out;
+	}
+	if (!cell->attached_mem) {
+		cell->attached_mem = page_alloc(&mem_pool, 1, PAGE_USAGE_CELL);
+		if (!cell->attached_mem) {
+			err = -ENOMEM;
+			goto out;
+		}
+	}
+
+	budget_pages = arch_mem_region_page_budget(&mem);
+	err = page_budget_grow(&mem_pool, &cell->page_budget, budget_pages);
+	if (err)
+		goto out;
+	err = page_budget_grow(&mem_pool, &root_cell.page_budget,
+			       arch_root_cell_remap_pages(1));
+	if (err)
+		goto err_release_budget;
+
+	/* see cell_create for why the root mapping has to be 1:1 */
+	tmp = mem;
+	tmp.virt_start = tmp.phys_start;
+	err = cell_unmap_region(cpu_data, &root_cell, &tmp);
+	if (err)
+		goto err_remap_root;
+
+	err = cell_map_region(cpu_data, cell, &mem);
+	if (err)
+		goto err_unmap_cell;
+
+	cell->attached_mem[cell->num_attached_mem++] = mem;
+	err = mem_index_init(cell);
+	if (err) {
+		cell->num_attached_mem--;
+		goto err_unmap_cell;
+	}
+
+	printk("Attached memory region %p (size %p) to cell \"%s\"\n",
+	       mem.phys_start, mem.size, cell->config->name);
+
+	cell_mgmt_leave();
+
+	return 0;
+
+err_unmap_cell:
+	cell_unmap_region(cpu_data, cell, &mem);
+err_remap_root:
+	root_cell_remap_region(cpu_data, &mem);
+	page_budget_shrink(&mem_pool, &root_cell.page_budget,
+			   arch_root_cell_remap_pages(1));
+err_release_budget:
+	page_budget_shrink(&mem_pool, &cell->page_budget, budget_pages);
+out:
+	cell_mgmt_leave();
+
+	return err;
+}
+
+int cell_mem_detach(struct per_cpu *cpu_data, unsigned long id,
+		    unsigned long mem_address)
+{
+	struct jailhouse_memory mem;
+	struct cell *cell;
+	unsigned int n;
+	int err;
+
+	if (cpu_data->cell != &root_cell)
+		return -EPERM;
+
+	if (!cell_mgmt_enter())
+		return -EBUSY;
+
+	cell = cell_lookup(id);
+	if (!cell) {
+		err = -ENOENT;
+		goto out;
+	}
+
+	err = read_mem_region(cpu_data, mem_address, &mem);
+	if (err)
+		goto out;
+
+	/* only regions attached at runtime can be detached */
+	for (n = 0; n < cell->num_attached_mem; n++)
+		if (cell->attached_mem[n].phys_start == mem.phys_start &&
+		    cell->attached_mem[n].virt_start == mem.virt_start &&
+		    cell->attached_mem[n].size == mem.size)
+			break;
+	if (n == cell->num_attached_mem) {
+		err = -ENOENT;
+		goto out;
+	}
+	mem = cell->attached_mem[n];
+
+	/*
+	 * This cannot fail. The region was mapped as a whole before, thus no
+	 * hugepages need to be broken up to unmap it.
+	 */
+	cell_unmap_region(cpu_data, cell, &mem);
+	root_cell_remap_region(cpu_data, &mem);
+
+	/* shrinking the index is done in place and cannot fail */
+	cell->attached_mem[n] = cell->attached_mem[--cell->num_attached_mem];
+	mem_index_init(cell);
+
+	page_budget_shrink(&mem_pool, &root_cell.page_budget,
+			   arch_root_cell_remap_pages(1));
+	page_budget_shrink(&mem_pool, &cell->page_budget,
+			   arch_mem_region_page_budget(&mem));
+
+	printk("Detached memory region %p (size %p) from cell \"%s\"\n",
+	       mem.phys_start, mem.size, cell->config->name);
+
+out:
+	cell_mgmt_leave();
 
 	return err;
 }
@@ -424,29 +1233,64 @@ resume_out:
 int cell_get_state(struct per_cpu *cpu_data, unsigned long id)
 {
 	struct cell *cell;
+	u32 state;
 
 	if (cpu_data->cell != &root_cell)
 		return -EPERM;
 
 	/*
 	 * We do not need explicit synchronization with cell_create/destroy
-	 * because their cell_suspend(root_cell) will not return before we left
-	 * this hypercall.
+	 * because they only update the cell registry after their
+	 * cell_suspend(root_cell) which will not return before we left this
+	 * hypercall.
 	 */
-	for_each_cell(cell)
-		if (cell->id == id) {
-			u32 state = cell->comm_page.comm_region.cell_state;
-
-			switch (state) {
-			case JAILHOUSE_CELL_RUNNING:
-			case JAILHOUSE_CELL_SHUT_DOWN:
-			case JAILHOUSE_CELL_FAILED:
-				return state;
-			default:
-				return -EINVAL;
-			}
-		}
-	return -ENOENT;
+	cell = cell_lookup(id);
+	if (!cell)
+		return -ENOENT;
+
+	state = cell->comm_page.comm_region.cell_state;
+	switch (state) {
+	case JAILHOUSE_CELL_RUNNING:
+	case JAILHOUSE_CELL_SHUT_DOWN:
+	case JAILHOUSE_CELL_FAILED:
+		return state;
+	default:
+		return -EINVAL;
+	}
+}
+
+long cell_get_info(struct per_cpu *cpu_data, unsigned long id,
+		   unsigned long type)
+{
+	unsigned long pages;
+	struct cell *cell;
+
+	if (cpu_data->cell != &root_cell)
+		return -EPERM;
+
+	/* see cell_get_state for synchronization with cell_create/destroy */
+	cell = cell_lookup(id);
+	if (!cell)
+		return -ENOENT;
+
+	switch (type) {
+	case JAILHOUSE_CELL_INFO_PAGE_BUDGET:
+		return cell->page_budget.pages;
+	case JAILHOUSE_CELL_INFO_PAGE_BUDGET_USED:
+		return cell->page_budget.used;
+	case JAILHOUSE_CELL_INFO_PAGES_USED:
+		pages = cell->data_pages + cell->page_budget.used +
+			cell->snapshot_pages;
+		if (cell->cpu_set != &cell->small_cpu_set)
+			pages++;
+		if (cell->mem_index)
+			pages += mem_index_pages(cell->mem_index_capacity);
+		if (cell->attached_mem)
+			pages++;
+		return pages;
+	default:
+		return -EINVAL;
+	}
 }
 
 int shutdown(struct per_cpu *cpu_data)
@@ -464,14 +1308,23 @@ int shutdown(struct per_cpu *cpu_data)
 
 	if (cpu_data->shutdown_state == SHUTDOWN_NONE) {
 		state = SHUTDOWN_STARTED;
-		for (cell = root_cell.next; cell; cell = cell->next)
-			if (!cell_shutdown_ok(cell))
-				state = -EPERM;
+		for_each_non_root_cell(cell) {
+			ret = cell_request_shutdown(cell);
+			/* a refusal takes precedence over pending answers */
+			if (ret == -EPERM ||
+			    (ret != 0 && state == SHUTDOWN_STARTED))
+				state = ret;
+		}
+
+		/* the other cells are asked again on the next attempt */
+		if (state == -EPERM)
+			for_each_non_root_cell(cell)
+				cell_clear_shutdown_request(cell);
 
 		if (state == SHUTDOWN_STARTED) {
 			printk("Shutting down hypervisor\n");
 
-			for (cell = root_cell.next; cell; cell = cell->next) {
+			for_each_non_root_cell(cell) {
 				cell_suspend(cell, cpu_data);
 
 				printk("Closing cell \"%s\"\n",
@@ -517,9 +1370,105 @@ long hypervisor_get_info(struct per_cpu *cpu_data, unsigned long type)
 		return remap_pool.used_pages;
 	case JAILHOUSE_INFO_NUM_CELLS:
 		return num_cells;
-	default:
+	case JAILHOUSE_INFO_MEM_POOL_PEAK_USED:
+		return mem_pool.peak_used_pages;
+	case JAILHOUSE_INFO_MEM_POOL_LARGEST_FREE:
+		return page_pool_largest_free(&mem_pool);
+	case JAILHOUSE_INFO_MEM_POOL_ALLOC_FAILURES:
+		return mem_pool.alloc_failures;
+	case JAILHOUSE_INFO_MEM_POOL_USED_HV_PT:
+		return mem_pool.usage_pages[PAGE_USAGE_HV_PT];
+	case JAILHOUSE_INFO_MEM_POOL_USED_CELL_PT:
+		return mem_pool.usage_pages[PAGE_USAGE_CELL_PT];
+	case JAILHOUSE_INFO_MEM_POOL_USED_IOMMU_PT:
+		return mem_pool.usage_pages[PAGE_USAGE_IOMMU_PT];
+	case JAILHOUSE_INFO_MEM_POOL_USED_CELLS:
+		return mem_pool.usage_pages[PAGE_USAGE_CELL];
+	case JAILHOUSE_INFO_MEM_POOL_USED_CPU_SETS:
+		return mem_pool.usage_pages[PAGE_USAGE_CPU_SET];
+	}
+
+	if (type >= JAILHOUSE_INFO_MEM_POOL_FREE_BLOCKS(0) &&
+	    type <= JAILHOUSE_INFO_MEM_POOL_FREE_BLOCKS(PAGE_POOL_MAX_ORDER))
+		return mem_pool.free_blocks[type -
+			JAILHOUSE_INFO_MEM_POOL_FREE_BLOCKS(0)];
+
+	return -EINVAL;
+}
+
+int cpu_move(struct per_cpu *cpu_data, unsigned long cpu_id,
+	     unsigned long id)
+{
+	struct cell *source, *target;
+	u32 source_state;
+	int err = 0;
+
+	if (cpu_data->cell != &root_cell)
+		return -EPERM;
+
+	if (!cpu_id_valid(cpu_id))
 		return -EINVAL;
+
+	if (!cell_mgmt_enter())
+		return -EBUSY;
+
+	target = cell_lookup(id);
+	if (!target) {
+		err = -ENOENT;
+		goto out;
+	}
+
+	source = per_cpu(cpu_id)->cell;
+	if (source == target)
+		goto out;
+
+	/* keep the calling CPU and at least one CPU in the source cell */
+	if (cpu_id == cpu_data->cpu_id ||
+	    next_cpu(-1, source->cpu_set, cpu_id) >
+	    source->cpu_set->max_cpu_id) {
+		err = -EBUSY;
+		goto out;
+	}
+
+	/*
+	 * The root cell takes the CPU offline before asking for the move.
+	 * Taking a CPU away from a running non-root cell would require a
+	 * handshake via its communication region, which is not supported.
+	 * Such cells have to be shut down or failed first.
+	 */
+	source_state = source->comm_page.comm_region.cell_state;
+	if (source != &root_cell &&
+	    source_state != JAILHOUSE_CELL_SHUT_DOWN &&
+	    source_state != JAILHOUSE_CELL_FAILED) {
+		err = -EBUSY;
+		goto out;
+	}
+
+	if (cpu_id > target->cpu_set->max_cpu_id) {
+		err = -EINVAL;
+		goto out;
 	}
+
+	/* only the moved CPU is stopped, both cells keep running */
+	arch_suspend_cpu(cpu_id);
+
+	clear_bit(cpu_id, source->cpu_set->bitmap);
+	set_bit(cpu_id, target->cpu_set->bitmap);
+	cell_assign_cpu(target, cpu_id);
+
+	arch_cell_cpus_changed(source);
+	arch_cell_cpus_changed(target);
+
+	printk("Moved CPU %lu from cell \"%s\" to \"%s\"\n", cpu_id,
+	       source->config->name, target->config->name);
+
+	/* the CPU waits for being started by the target cell */
+	arch_park_cpu(cpu_id);
+
+out:
+	cell_mgmt_leave();
+
+	return err;
 }
 
 int cpu_get_state(struct per_cpu *cpu_data, unsigned long cpu_id)
@@ -541,6 +1490,73 @@ int cpu_get_state(struct per_cpu *cpu_data, unsigned long cpu_id)
 		JAILHOUSE_CPU_RUNNING;
 }
 
+int cell_get_stat(struct per_cpu *cpu_data, unsigned long id,
+		  unsigned long address)
+{
+	struct jailhouse_cell_stats *stats;
+	unsigned int cpu, type;
+	struct cell *cell;
+	int err;
+
+	if (cpu_data->cell != &root_cell)
+		return -EPERM;
+
+	/* see cell_get_state for synchronization with cell_create/destroy */
+	cell = cell_lookup(id);
+	if (!cell)
+		return -ENOENT;
+
+	err = map_root_buffer(cpu_data, address, sizeof(*stats),
+			      (void **)&stats);
+	if (err)
+		return err;
+
+	/* counters of running CPUs are read without synchronization */
+	for (type = 0; type < JAILHOUSE_NUM_CPU_STATS; type++) {
+		stats->counters[type] = 0;
+		for_each_cpu(cpu, cell->cpu_set)
+			stats->counters[type] += per_cpu(cpu)->stats[type];
+	}
+
+	return 0;
+}
+
+int cpu_get_latency(struct per_cpu *cpu_data, unsigned long cpu_id,
+		    unsigned long address, unsigned long flags)
+{
+	struct per_cpu *target_data;
+	void *buffer;
+	int err;
+
+	if (cpu_data->cell != &root_cell)
+		return -EPERM;
+
+	if (!cpu_id_valid(cpu_id) || flags & ~JAILHOUSE_CPU_LATENCY_RESET)
+		return -EINVAL;
+
+	err = map_root_buffer(cpu_data, address,
+			      sizeof(struct jailhouse_cpu_latency), &buffer);
+	if (err)
+		return err;
+
+	/*
+	 * Histograms of running CPUs are copied without synchronization. As
+	 * long as a requested reset has not been performed by the target on
+	 * its next VM exit, report the empty histograms it will start with.
+	 */
+	target_data = per_cpu(cpu_id);
+	if (target_data->latency_reset)
+		memset(buffer, 0, sizeof(target_data->latency));
+	else
+		memcpy(buffer, &target_data->latency,
+		       sizeof(target_data->latency));
+
+	if (flags & JAILHOUSE_CPU_LATENCY_RESET)
+		target_data->latency_reset = true;
+
+	return 0;
+}
+
 void panic_stop(struct per_cpu *cpu_data)
 {
 	panic_printk("Stopping CPU");
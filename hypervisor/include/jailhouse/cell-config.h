@@ -16,6 +16,8 @@
 #define JAILHOUSE_CELL_NAME_MAXLEN	31
 
 #define JAILHOUSE_CELL_UNMANAGED_EXIT	0x00000001
+/* report a hypervisor and answer its CPUID leaf 0x40000000 */
+#define JAILHOUSE_CELL_CPUID_HYPERVISOR	0x00000002
 
 struct jailhouse_cell_desc {
 	char name[JAILHOUSE_CELL_NAME_MAXLEN+1];
@@ -26,8 +28,9 @@ struct jailhouse_cell_desc {
 	__u32 num_irq_lines;
 	__u32 pio_bitmap_size;
 	__u32 num_pci_devices;
+	__u32 num_cpuid_masks;
 
-	__u32 padding[2];
+	__u32 padding;
 };
 
 #define JAILHOUSE_MEM_READ		0x0001
@@ -35,12 +38,15 @@ struct jailhouse_cell_desc {
 #define JAILHOUSE_MEM_EXECUTE		0x0004
 #define JAILHOUSE_MEM_DMA		0x0008
 #define JAILHOUSE_MEM_COMM_REGION	0x0010
+/* contents at cell creation can be restored when restarting the cell */
+#define JAILHOUSE_MEM_SNAPSHOT		0x0020
 
 #define JAILHOUSE_MEM_VALID_FLAGS	(JAILHOUSE_MEM_READ | \
 					 JAILHOUSE_MEM_WRITE | \
 					 JAILHOUSE_MEM_EXECUTE | \
 					 JAILHOUSE_MEM_DMA | \
-					 JAILHOUSE_MEM_COMM_REGION)
+					 JAILHOUSE_MEM_COMM_REGION | \
+					 JAILHOUSE_MEM_SNAPSHOT)
 
 struct jailhouse_memory {
 	__u64 phys_start;
@@ -64,6 +70,21 @@ struct jailhouse_pci_device {
 	__u8 devfn;
 } __attribute__((packed));
 
+#define JAILHOUSE_CPUID_EAX		0
+#define JAILHOUSE_CPUID_EBX		1
+#define JAILHOUSE_CPUID_ECX		2
+#define JAILHOUSE_CPUID_EDX		3
+
+/* the function does not take a sub-leaf index in ecx */
+#define JAILHOUSE_CPUID_NO_INDEX	0xffffffff
+
+/* bits to clear from the CPUID results the cell sees */
+struct jailhouse_cpuid_mask {
+	__u32 function;
+	__u32 index;
+	__u32 clear[4];
+};
+
 struct jailhouse_system {
 	struct jailhouse_memory hypervisor_memory;
 	struct jailhouse_memory config_memory;
@@ -78,7 +99,8 @@ jailhouse_cell_config_size(struct jailhouse_cell_desc *cell)
 		cell->num_memory_regions * sizeof(struct jailhouse_memory) +
 		cell->num_irq_lines * sizeof(struct jailhouse_irq_line) +
 		cell->pio_bitmap_size +
-		cell->num_pci_devices * sizeof(struct jailhouse_pci_device);
+		cell->num_pci_devices * sizeof(struct jailhouse_pci_device) +
+		cell->num_cpuid_masks * sizeof(struct jailhouse_cpuid_mask);
 }
 
 static inline __u32
@@ -122,4 +144,15 @@ jailhouse_cell_pci_devices(const struct jailhouse_cell_desc *cell)
 		cell->pio_bitmap_size);
 }
 
+static inline const struct jailhouse_cpuid_mask *
+jailhouse_cell_cpuid_masks(const struct jailhouse_cell_desc *cell)
+{
+	return (const struct jailhouse_cpuid_mask *)((void *)cell +
+		sizeof(struct jailhouse_cell_desc) + cell->cpu_set_size +
+		cell->num_memory_regions * sizeof(struct jailhouse_memory) +
+		cell->num_irq_lines * sizeof(struct jailhouse_irq_line) +
+		cell->pio_bitmap_size +
+		cell->num_pci_devices * sizeof(struct jailhouse_pci_device));
+}
+
 #endif /* !_JAILHOUSE_CELL_CONFIG_H */
@@ -38,16 +38,31 @@ bool cpu_id_valid(unsigned long cpu_id);
 
 int check_mem_regions(const struct jailhouse_cell_desc *config);
 int cell_init(struct cell *cell, bool copy_cpu_set);
+void cell_register(struct cell *cell);
 
 int cell_create(struct per_cpu *cpu_data, unsigned long config_address);
 int cell_destroy(struct per_cpu *cpu_data, unsigned long id);
+int cell_start(struct per_cpu *cpu_data, unsigned long id,
+	       unsigned long flags);
+int cell_mem_attach(struct per_cpu *cpu_data, unsigned long id,
+		    unsigned long mem_address);
+int cell_mem_detach(struct per_cpu *cpu_data, unsigned long id,
+		    unsigned long mem_address);
+int cpu_move(struct per_cpu *cpu_data, unsigned long cpu_id,
+	     unsigned long id);
 int cell_get_state(struct per_cpu *cpu_data, unsigned long id);
+long cell_get_info(struct per_cpu *cpu_data, unsigned long id,
+		   unsigned long type);
+int cell_get_stat(struct per_cpu *cpu_data, unsigned long id,
+		  unsigned long address);
 
 int shutdown(struct per_cpu *cpu_data);
 
 long hypervisor_get_info(struct per_cpu *cpu_data, unsigned long type);
 
 int cpu_get_state(struct per_cpu *cpu_data, unsigned long id);
+int cpu_get_latency(struct per_cpu *cpu_data, unsigned long cpu_id,
+		    unsigned long address, unsigned long flags);
 
 void __attribute__((noreturn)) panic_stop(struct per_cpu *cpu_data);
 void panic_halt(struct per_cpu *cpu_data);
@@ -63,9 +78,23 @@ int arch_map_memory_region(struct cell *cell,
 int arch_unmap_memory_region(struct cell *cell,
 			     const struct jailhouse_memory *mem);
 
+unsigned long arch_cell_page_budget(const struct jailhouse_cell_desc *config);
+unsigned long arch_mem_region_page_budget(const struct jailhouse_memory *mem);
+unsigned long arch_root_cell_remap_pages(unsigned int num_regions);
+
+/*
+ * Cell creation and destruction are split into phases that run while the
+ * root cell continues (create, destroy) and phases that require it to be
+ * suspended (commit, release).
+ */
 int arch_cell_create(struct per_cpu *cpu_data, struct cell *cell);
+int arch_cell_commit(struct per_cpu *cpu_data, struct cell *cell);
+void arch_cell_release(struct per_cpu *cpu_data, struct cell *cell);
 void arch_cell_destroy(struct per_cpu *cpu_data, struct cell *cell);
 
+void arch_flush_cell_caches(struct per_cpu *cpu_data, struct cell *cell);
+void arch_cell_cpus_changed(struct cell *cell);
+
 void arch_shutdown(void);
 
 void __attribute__((noreturn)) arch_panic_stop(struct per_cpu *cpu_data);
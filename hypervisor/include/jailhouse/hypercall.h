@@ -19,6 +19,13 @@
 #define JAILHOUSE_HC_HYPERVISOR_GET_INFO	3
 #define JAILHOUSE_HC_CELL_GET_STATE		4
 #define JAILHOUSE_HC_CPU_GET_STATE		5
+#define JAILHOUSE_HC_CELL_GET_INFO		6
+#define JAILHOUSE_HC_CELL_START			7
+#define JAILHOUSE_HC_CELL_MEM_ATTACH		8
+#define JAILHOUSE_HC_CELL_MEM_DETACH		9
+#define JAILHOUSE_HC_CPU_MOVE			10
+#define JAILHOUSE_HC_CELL_GET_STAT		11
+#define JAILHOUSE_HC_CPU_GET_LATENCY		12
 
 /* Hypervisor information type */
 #define JAILHOUSE_INFO_MEM_POOL_SIZE		0
@@ -26,6 +33,54 @@
 #define JAILHOUSE_INFO_REMAP_POOL_SIZE		2
 #define JAILHOUSE_INFO_REMAP_POOL_USED		3
 #define JAILHOUSE_INFO_NUM_CELLS		4
+#define JAILHOUSE_INFO_MEM_POOL_PEAK_USED	5
+#define JAILHOUSE_INFO_MEM_POOL_LARGEST_FREE	6
+#define JAILHOUSE_INFO_MEM_POOL_ALLOC_FAILURES	7
+#define JAILHOUSE_INFO_MEM_POOL_USED_HV_PT	8
+#define JAILHOUSE_INFO_MEM_POOL_USED_CELL_PT	9
+#define JAILHOUSE_INFO_MEM_POOL_USED_IOMMU_PT	10
+#define JAILHOUSE_INFO_MEM_POOL_USED_CELLS	11
+#define JAILHOUSE_INFO_MEM_POOL_USED_CPU_SETS	12
+#define JAILHOUSE_INFO_MEM_POOL_FREE_BLOCKS(order)	(32 + (order))
+
+/* Cell information type */
+#define JAILHOUSE_CELL_INFO_PAGE_BUDGET		0
+#define JAILHOUSE_CELL_INFO_PAGE_BUDGET_USED	1
+#define JAILHOUSE_CELL_INFO_PAGES_USED		2
+
+/* Statistics counters, maintained per CPU and summed up per cell */
+#define JAILHOUSE_CPU_STAT_VMEXITS_TOTAL	0
+#define JAILHOUSE_CPU_STAT_VMEXITS_MANAGEMENT	1
+#define JAILHOUSE_CPU_STAT_VMEXITS_HYPERCALL	2
+#define JAILHOUSE_CPU_STAT_VMEXITS_CPUID	3
+#define JAILHOUSE_CPU_STAT_VMEXITS_CR		4
+#define JAILHOUSE_CPU_STAT_VMEXITS_MSR		5
+#define JAILHOUSE_CPU_STAT_VMEXITS_X2APIC_ICR	6
+#define JAILHOUSE_CPU_STAT_VMEXITS_X2APIC	7
+#define JAILHOUSE_CPU_STAT_VMEXITS_XAPIC	8
+#define JAILHOUSE_CPU_STAT_VMEXITS_XAPIC_ICR	9
+#define JAILHOUSE_CPU_STAT_VMEXITS_XSETBV	10
+#define JAILHOUSE_NUM_CPU_STATS			11
+
+/* VM exit latency classes */
+#define JAILHOUSE_LATENCY_MANAGEMENT		0
+#define JAILHOUSE_LATENCY_HYPERCALL		1
+#define JAILHOUSE_LATENCY_CPUID			2
+#define JAILHOUSE_LATENCY_CR			3
+#define JAILHOUSE_LATENCY_MSR			4
+#define JAILHOUSE_LATENCY_XAPIC			5
+#define JAILHOUSE_LATENCY_XSETBV		6
+#define JAILHOUSE_LATENCY_OTHER			7
+#define JAILHOUSE_NUM_LATENCY_CLASSES		8
+
+/* bucket n counts exits of 2^n to 2^(n+1)-1 cycles, the last one all above */
+#define JAILHOUSE_LATENCY_BUCKETS		32
+
+/* CPU get latency flags */
+#define JAILHOUSE_CPU_LATENCY_RESET		0x0001
+
+/* Cell start flags */
+#define JAILHOUSE_CELL_START_RESTORE		0x0001
 
 /* CPU state */
 #define JAILHOUSE_CPU_RUNNING			0
@@ -45,6 +100,17 @@
 #define JAILHOUSE_CELL_SHUT_DOWN		1 /* terminal state */
 #define JAILHOUSE_CELL_FAILED			2 /* terminal state */
 
+/* VM exit statistics of a cell, summed up over its CPUs */
+struct jailhouse_cell_stats {
+	__u64 counters[JAILHOUSE_NUM_CPU_STATS];
+};
+
+/* VM exit latencies of a CPU, measured in TSC cycles */
+struct jailhouse_cpu_latency {
+	__u64 max_cycles[JAILHOUSE_NUM_LATENCY_CLASSES];
+	__u32 buckets[JAILHOUSE_NUM_LATENCY_CLASSES][JAILHOUSE_LATENCY_BUCKETS];
+};
+
 struct jailhouse_comm_region {
 	volatile __u32 msg_to_cell;
 	volatile __u32 reply_from_cell;
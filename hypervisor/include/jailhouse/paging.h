@@ -16,20 +16,110 @@
 #include <jailhouse/entry.h>
 #include <asm/types.h>
 #include <asm/paging.h>
+#include <asm/spinlock.h>
 
 #define PAGE_ALIGN(s)		((s + PAGE_SIZE-1) & PAGE_MASK)
 
 #define TEMPORARY_MAPPING_BASE	REMAP_BASE
+#define NUM_CPU_MAPPING_PAGES	(NUM_TEMPORARY_PAGES + NUM_GUEST_TLB_PAGES)
 #define TEMPORARY_MAPPING_CPU_BASE(cpu_data)				\
 	(TEMPORARY_MAPPING_BASE + (cpu_data)->cpu_id * PAGE_SIZE *	\
-	 NUM_TEMPORARY_PAGES)
+	 NUM_CPU_MAPPING_PAGES)
+/* guest page tables cached by the guest TLB, behind the temporary pages */
+#define GUEST_TLB_MAPPING_CPU_BASE(cpu_data)				\
+	(TEMPORARY_MAPPING_CPU_BASE(cpu_data) +				\
+	 NUM_TEMPORARY_PAGES * PAGE_SIZE)
+
+#define PAGE_POOL_MAX_ORDER	18
+
+/* Purpose of allocated pages, accounted per pool. */
+enum page_usage {
+	PAGE_USAGE_OTHER,
+	/** Page tables of the hypervisor. */
+	PAGE_USAGE_HV_PT,
+	/** Guest-physical page tables of cells (EPT). */
+	PAGE_USAGE_CELL_PT,
+	/** IOMMU page and context tables (VT-d). */
+	PAGE_USAGE_IOMMU_PT,
+	/** Cell control structures and configurations. */
+	PAGE_USAGE_CELL,
+	/** CPU sets too large to be embedded into the cell. */
+	PAGE_USAGE_CPU_SET,
+	PAGE_USAGE_MAX
+};
+
+/* Per-page state of a pool that is managed by the buddy allocator. */
+struct page_frame {
+	/** Free list links (page numbers), valid for free block heads. */
+	u32 next;
+	u32 prev;
+	/** Order of the free block this page is the head of. */
+	u8 order;
+	u8 flags;
+	/** Number of valid entries if the page is used as page table. */
+	u16 pt_entries;
+	/** Next page on the pool's list of pages pending scrubbing. */
+	u32 dirty_next;
+	/** Purpose of the page while it is allocated. */
+	u8 usage;
+};
+
+/* Pages reserved in a pool for one owner, e.g. a cell. */
+struct page_budget {
+	/** Number of reserved pages. */
+	unsigned long pages;
+	/** Pages allocated against the budget. */
+	unsigned long used;
+	/** If set, allocations beyond the budget fail, otherwise they are
+	 * served from the unreserved part of the pool. */
+	bool strict;
+};
+
+#define PAGE_CACHE_PAGES	8
+
+/*
+ * Pages set aside for the page table allocations of one CPU, so that it does
+ * not have to take the pool lock for them.
+ */
+struct page_cache {
+	unsigned int num;
+	void *pages[PAGE_CACHE_PAGES];
+};
 
 struct page_pool {
+	/** Serializes allocations and releases which may be issued by
+	 * several CPUs in parallel. */
+	spinlock_t lock;
 	void *base_address;
 	unsigned long pages;
 	unsigned long used_pages;
 	unsigned long *used_bitmap;
+	/** One bit per used_bitmap word, set if all pages of the word are in
+	 * use, or NULL if no summary is maintained. */
+	unsigned long *used_summary;
+	/** Page number at which the next bitmap scan starts (next-fit). */
+	unsigned long next_hint;
 	unsigned long flags;
+	/** Allocation statistics, latencies are in CPU cycles. */
+	unsigned long alloc_calls;
+	unsigned long alloc_cycles;
+	unsigned long alloc_max_cycles;
+	unsigned long alloc_failures;
+	/** Highest number of pages that were in use at the same time. */
+	unsigned long peak_used_pages;
+	/** Pages in use per purpose, only maintained with buddy state. */
+	unsigned long usage_pages[PAGE_USAGE_MAX];
+	/** Per-page buddy state or NULL if the pool is only bitmap-managed. */
+	struct page_frame *frames;
+	/** Heads of the free block lists, indexed by block order. */
+	u32 free_list[PAGE_POOL_MAX_ORDER + 1];
+	/** Number of free blocks per order. */
+	unsigned long free_blocks[PAGE_POOL_MAX_ORDER + 1];
+	/** Reserved pages of all budgets that are not yet allocated. */
+	unsigned long reserved_pages;
+	/** Freed pages that still have to be scrubbed before reuse. */
+	u32 dirty_list;
+	unsigned long dirty_pages;
 };
 
 enum page_map_coherent {
@@ -68,14 +158,18 @@ struct paging {
 
 	/** Invalidate entry. */
 	void (*clear_entry)(pt_entry_t pte);
-
-	/** Returns true if given page table contains no valid entries. */
-	bool (*page_table_empty)(page_table_t page_table);
 };
 
 struct paging_structures {
 	const struct paging *root_paging;
 	page_table_t root_table;
+	/** Purpose to account allocated page tables to. */
+	enum page_usage usage;
+	/** Budget to charge allocated page tables to, or NULL. */
+	struct page_budget *budget;
+	/** Cache to take page tables from before using the pool, or NULL.
+	 * The cache has to be filled for the same usage and budget. */
+	struct page_cache *cache;
 };
 
 struct guest_paging_structures {
@@ -83,6 +177,35 @@ struct guest_paging_structures {
 	unsigned long root_table_gphys;
 };
 
+#define GUEST_TLB_ENTRIES	8
+#define GUEST_TLB_MAX_LEVELS	4
+#define NUM_GUEST_TLB_PAGES	(GUEST_TLB_ENTRIES * GUEST_TLB_MAX_LEVELS)
+
+/* Cached translation of a guest virtual page. */
+struct guest_tlb_entry {
+	const struct paging *root_paging;
+	unsigned long root_table_gphys;
+	unsigned long virt;
+	unsigned long gphys;
+	unsigned long phys;
+	/** Number of guest page table levels the translation walked. The
+	 * tables remain mapped at the entry's slots of the guest TLB mapping
+	 * area as long as the generation is unchanged. */
+	unsigned int levels;
+	/** Guest address of the next-level table each non-leaf entry
+	 * pointed to. */
+	unsigned long next_table_gphys[GUEST_TLB_MAX_LEVELS - 1];
+	unsigned long generation;
+};
+
+/* Per-CPU cache of guest page translations. */
+struct guest_tlb {
+	struct guest_tlb_entry entry[GUEST_TLB_ENTRIES];
+	/** Entries of other generations are invalid. */
+	unsigned long generation;
+	unsigned int next_victim;
+};
+
 #include <asm/paging_modes.h>
 
 extern unsigned long page_offset;
@@ -94,8 +217,23 @@ extern struct paging_structures hv_paging_structs;
 
 unsigned long page_map_get_phys_invalid(pt_entry_t pte, unsigned long virt);
 
-void *page_alloc(struct page_pool *pool, unsigned int num);
+void *page_alloc(struct page_pool *pool, unsigned int num,
+		 enum page_usage usage);
 void page_free(struct page_pool *pool, void *first_page, unsigned int num);
+void *page_budget_alloc(struct page_pool *pool, struct page_budget *budget,
+			unsigned int num, enum page_usage usage);
+void page_budget_free(struct page_pool *pool, struct page_budget *budget,
+		      void *first_page, unsigned int num);
+int page_budget_grow(struct page_pool *pool, struct page_budget *budget,
+		     unsigned long pages);
+void page_budget_shrink(struct page_pool *pool, struct page_budget *budget,
+			unsigned long pages);
+int page_cache_fill(struct page_pool *pool, struct page_budget *budget,
+		    struct page_cache *cache, enum page_usage usage);
+void page_cache_drain(struct page_pool *pool, struct page_budget *budget,
+		      struct page_cache *cache);
+void page_pool_scrub(struct page_pool *pool);
+unsigned long page_pool_largest_free(const struct page_pool *pool);
 
 static inline unsigned long page_map_hvirt2phys(const void *hvirt)
 {
@@ -119,10 +257,14 @@ int page_map_create(const struct paging_structures *pg_structs,
 int page_map_destroy(const struct paging_structures *pg_structs,
 		     unsigned long virt, unsigned long size,
 		     enum page_map_coherent coherent);
+page_table_t page_map_root_subtable(const struct paging_structures *pg_structs,
+				    unsigned long virt,
+				    enum page_map_coherent coherent);
 
 void *page_map_get_guest_page(struct per_cpu *cpu_data,
 			      const struct guest_paging_structures *pg_structs,
 			      unsigned long virt, unsigned long flags);
+void page_map_guest_tlb_flush(struct per_cpu *cpu_data);
 
 int paging_init(void);
 void arch_paging_init(void);
@@ -10,7 +10,10 @@
  * the COPYING file in the top-level directory.
  */
 
+#include <asm/string.h>
+
 void *memcpy(void *d, const void *s, unsigned long n);
 void *memset(void *s, int c, unsigned long n);
+int memcmp(const void *s1, const void *s2, unsigned long n);
 
 int strcmp(const char *s1, const char *s2);
@@ -13,14 +13,71 @@
 #include <jailhouse/string.h>
 #include <asm/types.h>
 
+#define WORD_SIZE		sizeof(unsigned long)
+#define WORD_ALIGNED(p)		(((unsigned long)(p) & (WORD_SIZE - 1)) == 0)
+
+#ifndef __HAVE_ARCH_MEMSET
 void *memset(void *s, int c, unsigned long n)
 {
+	unsigned long *w, pattern;
 	u8 *p = s;
 
-	while (n-- > 0)
+	for (; n > 0 && !WORD_ALIGNED(p); n--)
+		*p++ = c;
+
+	pattern = (u8)c * (~0UL / 0xff);
+	for (w = (unsigned long *)p; n >= WORD_SIZE; n -= WORD_SIZE)
+		*w++ = pattern;
+
+	for (p = (u8 *)w; n > 0; n--)
 		*p++ = c;
 	return s;
 }
+#endif
+
+#ifndef __HAVE_ARCH_MEMCPY
+void *memcpy(void *dest, const void *src, unsigned long n)
+{
+	const u8 *s = src;
+	u8 *d = dest;
+
+	/* word-wise copy is only possible if both sides can be aligned */
+	if (((unsigned long)d & (WORD_SIZE - 1)) ==
+	    ((unsigned long)s & (WORD_SIZE - 1))) {
+		for (; n > 0 && !WORD_ALIGNED(d); n--)
+			*d++ = *s++;
+		for (; n >= WORD_SIZE; n -= WORD_SIZE) {
+			*(unsigned long *)d = *(const unsigned long *)s;
+			d += WORD_SIZE;
+			s += WORD_SIZE;
+		}
+	}
+
+	while (n-- > 0)
+		*d++ = *s++;
+	return dest;
+}
+#endif
+
+int memcmp(const void *s1, const void *s2, unsigned long n)
+{
+	const u8 *p1 = s1, *p2 = s2;
+
+	/* skip over equal words, the differing one is then compared bytewise */
+	if (WORD_ALIGNED(p1) && WORD_ALIGNED(p2))
+		for (; n >= WORD_SIZE; n -= WORD_SIZE) {
+			if (*(const unsigned long *)p1 !=
+			    *(const unsigned long *)p2)
+				break;
+			p1 += WORD_SIZE;
+			p2 += WORD_SIZE;
+		}
+
+	for (; n > 0; n--, p1++, p2++)
+		if (*p1 != *p2)
+			return *p1 - *p2;
+	return 0;
+}
 
 int strcmp(const char *s1, const char *s2)
 {
@@ -20,16 +20,35 @@
 
 #define INVALID_PAGE_NR		(~0UL)
 
-#define PAGE_SCRUB_ON_FREE	0x1
+#define PAGE_SCRUB_FREED	0x1
+
+#define PAGE_FRAME_FREE		0x1
+#define PAGE_FRAME_DIRTY	0x2
+#define PAGE_FRAME_DIRTY_LISTED	0x4
+
+#define FRAME_LIST_END		(~0U)
+
+/* Number of pages above which the whole TLB is flushed instead. */
+#ifndef CONFIG_TLB_FLUSH_THRESHOLD
+#define CONFIG_TLB_FLUSH_THRESHOLD	32
+#endif
 
 extern u8 __page_pool[];
 
 unsigned long page_offset;
 
 struct page_pool mem_pool;
+/*
+ * The remapping pool has no backing memory and is only allocated from during
+ * setup, so it is managed by plain bitmap scans instead of the buddy allocator.
+ */
+static unsigned long remap_pool_summary[NUM_REMAP_BITMAP_PAGES *
+					BITS_PER_PAGE / BITS_PER_LONG /
+					BITS_PER_LONG];
 struct page_pool remap_pool = {
 	.base_address = (void *)REMAP_BASE,
 	.pages = BITS_PER_PAGE * NUM_REMAP_BITMAP_PAGES,
+	.used_summary = remap_pool_summary,
 };
 
 struct paging_structures hv_paging_structs;
@@ -42,7 +61,8 @@ unsigned long page_map_get_phys_invalid(pt_entry_t pte, unsigned long virt)
 static unsigned long find_next_free_page(struct page_pool *pool,
 					 unsigned long start)
 {
-	unsigned long bmp_pos, bmp_val, page_nr;
+	unsigned long bmp_words = pool->pages / BITS_PER_LONG;
+	unsigned long bmp_pos, bmp_val, sum_val, free_pos, page_nr;
 	unsigned long start_mask = 0;
 
 	if (start >= pool->pages)
@@ -55,8 +75,31 @@ static unsigned long find_next_free_page(struct page_pool *pool,
 	if (start % BITS_PER_LONG > 0)
 		start_mask = ~0UL >> (BITS_PER_LONG - (start % BITS_PER_LONG));
 
-	for (bmp_pos = start / BITS_PER_LONG;
-	     bmp_pos < pool->pages / BITS_PER_LONG; bmp_pos++) {
+	bmp_pos = start / BITS_PER_LONG;
+	while (bmp_pos < bmp_words) {
+		if (pool->used_summary) {
+			/*
+			 * Consult the summary to skip bitmap words that are
+			 * completely in use, up to a whole summary word at
+			 * once.
+			 */
+			sum_val = pool->used_summary[bmp_pos / BITS_PER_LONG] |
+				~(~0UL << (bmp_pos % BITS_PER_LONG));
+			if (sum_val == ~0UL) {
+				bmp_pos = (bmp_pos / BITS_PER_LONG + 1) *
+					BITS_PER_LONG;
+				start_mask = 0;
+				continue;
+			}
+			free_pos = (bmp_pos & ~(BITS_PER_LONG - 1)) +
+				ffzl(sum_val);
+			if (free_pos != bmp_pos) {
+				bmp_pos = free_pos;
+				start_mask = 0;
+				if (bmp_pos >= bmp_words)
+					break;
+			}
+		}
 		bmp_val = pool->used_bitmap[bmp_pos] | start_mask;
 		start_mask = 0;
 		if (bmp_val != ~0UL) {
@@ -65,55 +108,442 @@ static unsigned long find_next_free_page(struct page_pool *pool,
 				break;
 			return page_nr;
 		}
+		bmp_pos++;
 	}
 
 	return INVALID_PAGE_NR;
 }
 
-void *page_alloc(struct page_pool *pool, unsigned int num)
+static void mark_page_used(struct page_pool *pool, unsigned long page_nr)
+{
+	unsigned long bmp_pos = page_nr / BITS_PER_LONG;
+
+	set_bit(page_nr, pool->used_bitmap);
+	if (pool->used_summary && pool->used_bitmap[bmp_pos] == ~0UL)
+		set_bit(bmp_pos, pool->used_summary);
+}
+
+static void mark_page_free(struct page_pool *pool, unsigned long page_nr)
+{
+	clear_bit(page_nr, pool->used_bitmap);
+	if (pool->used_summary)
+		clear_bit(page_nr / BITS_PER_LONG, pool->used_summary);
+}
+
+static unsigned long bitmap_alloc(struct page_pool *pool, unsigned long num,
+				  unsigned long from)
 {
 	unsigned long start, last, next;
-	unsigned int allocated;
+	unsigned long allocated;
 
-	start = find_next_free_page(pool, 0);
+	start = find_next_free_page(pool, from);
 	if (start == INVALID_PAGE_NR)
-		return NULL;
+		return INVALID_PAGE_NR;
 
 restart:
 	for (allocated = 1, last = start; allocated < num;
 	     allocated++, last = next) {
 		next = find_next_free_page(pool, last + 1);
 		if (next == INVALID_PAGE_NR)
-			return NULL;
+			return INVALID_PAGE_NR;
 		if (next != last + 1) {
 			start = next;
 			goto restart;
 		}
 	}
+	return start;
+}
 
-	for (allocated = 0; allocated < num; allocated++)
-		set_bit(start + allocated, pool->used_bitmap);
+static void buddy_list_add(struct page_pool *pool, unsigned long page_nr,
+			   unsigned int order)
+{
+	struct page_frame *frame = &pool->frames[page_nr];
+	u32 head = pool->free_list[order];
 
-	pool->used_pages += num;
+	frame->order = order;
+	frame->flags |= PAGE_FRAME_FREE;
+	frame->prev = FRAME_LIST_END;
+	frame->next = head;
+	if (head != FRAME_LIST_END)
+		pool->frames[head].prev = page_nr;
+	pool->free_list[order] = page_nr;
+	pool->free_blocks[order]++;
+}
 
-	return pool->base_address + start * PAGE_SIZE;
+static void buddy_list_del(struct page_pool *pool, unsigned long page_nr)
+{
+	struct page_frame *frame = &pool->frames[page_nr];
+
+	if (frame->prev != FRAME_LIST_END)
+		pool->frames[frame->prev].next = frame->next;
+	else
+		pool->free_list[frame->order] = frame->next;
+	if (frame->next != FRAME_LIST_END)
+		pool->frames[frame->next].prev = frame->prev;
+	frame->flags &= ~PAGE_FRAME_FREE;
+	pool->free_blocks[frame->order]--;
 }
 
-void page_free(struct page_pool *pool, void *page, unsigned int num)
+static void buddy_free_block(struct page_pool *pool, unsigned long page_nr,
+			     unsigned int order)
+{
+	unsigned long buddy;
+
+	/* merge with the buddy as long as it is a free block of same order */
+	while (order < PAGE_POOL_MAX_ORDER) {
+		buddy = page_nr ^ (1UL << order);
+		if (buddy >= pool->pages ||
+		    !(pool->frames[buddy].flags & PAGE_FRAME_FREE) ||
+		    pool->frames[buddy].order != order)
+			break;
+		buddy_list_del(pool, buddy);
+		page_nr &= ~(1UL << order);
+		order++;
+	}
+	buddy_list_add(pool, page_nr, order);
+}
+
+static void buddy_free_range(struct page_pool *pool, unsigned long page_nr,
+			     unsigned long num)
 {
+	unsigned int order;
+
+	/* release the range as a sequence of maximal, aligned blocks */
+	while (num > 0) {
+		order = 0;
+		while (order < PAGE_POOL_MAX_ORDER &&
+		       (page_nr & (1UL << order)) == 0 &&
+		       (2UL << order) <= num)
+			order++;
+		buddy_free_block(pool, page_nr, order);
+		page_nr += 1UL << order;
+		num -= 1UL << order;
+	}
+}
+
+static unsigned long buddy_alloc(struct page_pool *pool, unsigned long num)
+{
+	unsigned int order = 0, n;
 	unsigned long page_nr;
 
+	while ((1UL << order) < num)
+		order++;
+
+	for (n = order; n <= PAGE_POOL_MAX_ORDER; n++)
+		if (pool->free_list[n] != FRAME_LIST_END)
+			break;
+	if (n > PAGE_POOL_MAX_ORDER)
+		return INVALID_PAGE_NR;
+
+	page_nr = pool->free_list[n];
+	buddy_list_del(pool, page_nr);
+
+	/* split off upper halves until the block has the requested order */
+	while (n > order) {
+		n--;
+		buddy_list_add(pool, page_nr + (1UL << n), n);
+	}
+
+	/* give back what exceeds the requested number of pages */
+	buddy_free_range(pool, page_nr + num, (1UL << order) - num);
+
+	return page_nr;
+}
+
+static void scrub_page(struct page_pool *pool, unsigned long page_nr)
+{
+	clear_page(pool->base_address + page_nr * PAGE_SIZE);
+	pool->frames[page_nr].flags &= ~PAGE_FRAME_DIRTY;
+	pool->dirty_pages--;
+}
+
+/*
+ * Freed pages are not scrubbed immediately but queued on the dirty list.
+ * They are cleared either when they are allocated again or when the list is
+ * drained via page_pool_scrub, whatever comes first.
+ */
+static void mark_page_dirty(struct page_pool *pool, unsigned long page_nr)
+{
+	struct page_frame *frame;
+
+	if (!pool->frames) {
+		clear_page(pool->base_address + page_nr * PAGE_SIZE);
+		return;
+	}
+
+	frame = &pool->frames[page_nr];
+	frame->flags |= PAGE_FRAME_DIRTY;
+	pool->dirty_pages++;
+
+	if (!(frame->flags & PAGE_FRAME_DIRTY_LISTED)) {
+		frame->flags |= PAGE_FRAME_DIRTY_LISTED;
+		frame->dirty_next = pool->dirty_list;
+		pool->dirty_list = page_nr;
+	}
+}
+
+static void __attribute__((noreturn))
+page_pool_corrupted(struct page_pool *pool, unsigned long page_nr)
+{
+	panic_printk("FATAL: page pool corrupted, page %lu at %p\n", page_nr,
+		     pool->base_address + page_nr * PAGE_SIZE);
+	panic_stop(NULL);
+}
+
+/*
+ * Allocates num pages of which the given number is taken from reservations
+ * of the pool. The remainder has to fit into the unreserved free pages.
+ */
+static void *pool_alloc(struct page_pool *pool, unsigned int num,
+			enum page_usage usage, unsigned long reserved)
+{
+	unsigned long start, page_nr, cycles = get_cycles();
+	void *page = NULL;
+
+	if (num - reserved >
+	    pool->pages - pool->used_pages - pool->reserved_pages) {
+		start = INVALID_PAGE_NR;
+	} else if (pool->frames) {
+		start = buddy_alloc(pool, num);
+	} else {
+		/* next-fit, wrap around once if nothing is found */
+		start = bitmap_alloc(pool, num, pool->next_hint);
+		if (start == INVALID_PAGE_NR && pool->next_hint > 0)
+			start = bitmap_alloc(pool, num, 0);
+		if (start != INVALID_PAGE_NR)
+			pool->next_hint = start + num;
+	}
+	if (start == INVALID_PAGE_NR) {
+		pool->alloc_failures++;
+		goto out;
+	}
+
+	for (page_nr = start; page_nr < start + num; page_nr++) {
+		if (test_bit(page_nr, pool->used_bitmap))
+			page_pool_corrupted(pool, page_nr);
+		mark_page_used(pool, page_nr);
+		if (!pool->frames)
+			continue;
+		if (pool->frames[page_nr].flags & PAGE_FRAME_DIRTY)
+			scrub_page(pool, page_nr);
+		pool->frames[page_nr].pt_entries = 0;
+		pool->frames[page_nr].usage = usage;
+	}
+
+	pool->used_pages += num;
+	pool->reserved_pages -= reserved;
+	if (pool->used_pages > pool->peak_used_pages)
+		pool->peak_used_pages = pool->used_pages;
+	if (pool->frames)
+		pool->usage_pages[usage] += num;
+	page = pool->base_address + start * PAGE_SIZE;
+
+out:
+	cycles = get_cycles() - cycles;
+	pool->alloc_calls++;
+	pool->alloc_cycles += cycles;
+	if (cycles > pool->alloc_max_cycles)
+		pool->alloc_max_cycles = cycles;
+
+	return page;
+}
+
+void *page_alloc(struct page_pool *pool, unsigned int num,
+		 enum page_usage usage)
+{
+	void *page;
+
+	spin_lock(&pool->lock);
+	page = pool_alloc(pool, num, usage, 0);
+	spin_unlock(&pool->lock);
+
+	return page;
+}
+
+/* pool lock has to be held */
+static void pool_free(struct page_pool *pool, void *page, unsigned int num)
+{
+	unsigned long page_nr, first_page_nr;
+	unsigned int n;
+
+	first_page_nr = (page - pool->base_address) / PAGE_SIZE;
+
+	for (n = 0, page_nr = first_page_nr; n < num; n++, page_nr++) {
+		if (!test_bit(page_nr, pool->used_bitmap))
+			page_pool_corrupted(pool, page_nr);
+		mark_page_free(pool, page_nr);
+		if (pool->frames)
+			pool->usage_pages[pool->frames[page_nr].usage]--;
+		if (pool->flags & PAGE_SCRUB_FREED)
+			mark_page_dirty(pool, page_nr);
+	}
+
+	pool->used_pages -= num;
+
+	if (pool->frames)
+		buddy_free_range(pool, first_page_nr, num);
+}
+
+void page_free(struct page_pool *pool, void *page, unsigned int num)
+{
 	if (!page)
 		return;
 
-	while (num-- > 0) {
-		if (pool->flags & PAGE_SCRUB_ON_FREE)
-			memset(page, 0, PAGE_SIZE);
-		page_nr = (page - pool->base_address) / PAGE_SIZE;
-		clear_bit(page_nr, pool->used_bitmap);
-		pool->used_pages--;
-		page += PAGE_SIZE;
+	spin_lock(&pool->lock);
+	pool_free(pool, page, num);
+	spin_unlock(&pool->lock);
+}
+
+static unsigned long budget_unused(const struct page_budget *budget)
+{
+	return budget->pages > budget->used ? budget->pages - budget->used : 0;
+}
+
+/*
+ * Allocates pages against the given budget, drawing them from its
+ * reservation as far as possible. A NULL budget is equivalent to page_alloc.
+ */
+void *page_budget_alloc(struct page_pool *pool, struct page_budget *budget,
+			unsigned int num, enum page_usage usage)
+{
+	unsigned long unused;
+	void *page = NULL;
+
+	if (!budget)
+		return page_alloc(pool, num, usage);
+
+	spin_lock(&pool->lock);
+
+	unused = budget_unused(budget);
+	if (budget->strict && num > unused) {
+		pool->alloc_failures++;
+		goto out;
+	}
+
+	page = pool_alloc(pool, num, usage, num < unused ? num : unused);
+	if (page)
+		budget->used += num;
+
+out:
+	spin_unlock(&pool->lock);
+	return page;
+}
+
+void page_budget_free(struct page_pool *pool, struct page_budget *budget,
+		      void *page, unsigned int num)
+{
+	unsigned long unused;
+
+	if (!budget || !page) {
+		page_free(pool, page, num);
+		return;
+	}
+
+	spin_lock(&pool->lock);
+
+	pool_free(pool, page, num);
+
+	unused = budget_unused(budget);
+	budget->used -= num;
+	pool->reserved_pages += budget_unused(budget) - unused;
+
+	spin_unlock(&pool->lock);
+}
+
+/* Extends the reservation of a budget, failing if the pool is too small. */
+int page_budget_grow(struct page_pool *pool, struct page_budget *budget,
+		     unsigned long pages)
+{
+	unsigned long unused;
+	int err = 0;
+
+	spin_lock(&pool->lock);
+
+	unused = budget_unused(budget);
+	if (pages > pool->pages - pool->used_pages - pool->reserved_pages) {
+		err = -ENOMEM;
+	} else {
+		budget->pages += pages;
+		pool->reserved_pages += budget_unused(budget) - unused;
+	}
+
+	spin_unlock(&pool->lock);
+	return err;
+}
+
+void page_budget_shrink(struct page_pool *pool, struct page_budget *budget,
+			unsigned long pages)
+{
+	unsigned long unused;
+
+	spin_lock(&pool->lock);
+
+	unused = budget_unused(budget);
+	budget->pages -= pages;
+	pool->reserved_pages -= unused - budget_unused(budget);
+
+	spin_unlock(&pool->lock);
+}
+
+/* Fills the cache with pages allocated against the budget. */
+int page_cache_fill(struct page_pool *pool, struct page_budget *budget,
+		    struct page_cache *cache, enum page_usage usage)
+{
+	void *page;
+
+	while (cache->num < PAGE_CACHE_PAGES) {
+		page = page_budget_alloc(pool, budget, 1, usage);
+		if (!page)
+			return -ENOMEM;
+		cache->pages[cache->num++] = page;
+	}
+	return 0;
+}
+
+/* Returns the pages left in the cache to the pool and the budget. */
+void page_cache_drain(struct page_pool *pool, struct page_budget *budget,
+		      struct page_cache *cache)
+{
+	while (cache->num > 0)
+		page_budget_free(pool, budget, cache->pages[--cache->num], 1);
+}
+
+void page_pool_scrub(struct page_pool *pool)
+{
+	struct page_frame *frame;
+	unsigned long page_nr;
+
+	spin_lock(&pool->lock);
+	while (pool->dirty_pages > 0) {
+		page_nr = pool->dirty_list;
+		frame = &pool->frames[page_nr];
+
+		pool->dirty_list = frame->dirty_next;
+		frame->flags &= ~PAGE_FRAME_DIRTY_LISTED;
+
+		/* pages reallocated meanwhile were already scrubbed */
+		if (frame->flags & PAGE_FRAME_DIRTY)
+			scrub_page(pool, page_nr);
+
+		/* give concurrent allocations a chance between pages */
+		spin_unlock(&pool->lock);
+		spin_lock(&pool->lock);
 	}
+	spin_unlock(&pool->lock);
+}
+
+/*
+ * Returns the largest number of contiguous pages that can currently be
+ * allocated in one go.
+ */
+unsigned long page_pool_largest_free(const struct page_pool *pool)
+{
+	int order;
+
+	for (order = PAGE_POOL_MAX_ORDER; order >= 0; order--)
+		if (pool->free_blocks[order] > 0)
+			return 1UL << order;
+	return 0;
 }
 
 unsigned long page_map_virt2phys(const struct paging_structures *pg_structs,
@@ -136,14 +566,126 @@ unsigned long page_map_virt2phys(const struct paging_structures *pg_structs,
 	}
 }
 
-static void flush_pt_entry(pt_entry_t pte, enum page_map_coherent coherent)
+/*
+ * Cache flushes of page table entries are collected per page_map_create or
+ * page_map_destroy call so that contiguously written entries are flushed
+ * together.
+ */
+struct pt_flush_batch {
+	enum page_map_coherent coherent;
+	pt_entry_t first, last;
+};
+
+static void flush_pt_batch(struct pt_flush_batch *batch)
 {
-	if (coherent == PAGE_MAP_COHERENT)
-		flush_cache(pte, sizeof(*pte));
+	if (batch->first) {
+		flush_cache(batch->first,
+			    (void *)(batch->last + 1) - (void *)batch->first);
+		batch->first = NULL;
+	}
+}
+
+static void flush_pt_entry(struct pt_flush_batch *batch, pt_entry_t pte)
+{
+	if (batch->coherent != PAGE_MAP_COHERENT)
+		return;
+
+	if (batch->first && pte == batch->last + 1) {
+		batch->last = pte;
+		return;
+	}
+	flush_pt_batch(batch);
+	batch->first = batch->last = pte;
+}
+
+/*
+ * All page tables built by the paging core come from mem_pool. Their number
+ * of valid entries is tracked in the buddy state of the table page, so that
+ * emptiness can be checked without scanning the table.
+ */
+static struct page_frame *pt_frame(const void *pt_addr)
+{
+	unsigned long table = (unsigned long)pt_addr & PAGE_MASK;
+
+	return &mem_pool.frames[(table - (unsigned long)mem_pool.base_address) /
+				PAGE_SIZE];
+}
+
+static void pt_entry_changed(const struct paging *paging, pt_entry_t pte,
+			     bool was_valid)
+{
+	bool valid = paging->entry_valid(pte);
+
+	if (valid && !was_valid)
+		pt_frame(pte)->pt_entries++;
+	else if (!valid && was_valid)
+		pt_frame(pte)->pt_entries--;
 }
 
-static int split_hugepage(const struct paging *paging, pt_entry_t pte,
-			  unsigned long virt, enum page_map_coherent coherent)
+static void pt_set_terminal(const struct paging *paging, pt_entry_t pte,
+			    unsigned long phys, unsigned long flags)
+{
+	bool was_valid = paging->entry_valid(pte);
+
+	paging->set_terminal(pte, phys, flags);
+	pt_entry_changed(paging, pte, was_valid);
+}
+
+static void pt_set_next_pt(const struct paging *paging, pt_entry_t pte,
+			   unsigned long next_pt)
+{
+	bool was_valid = paging->entry_valid(pte);
+
+	paging->set_next_pt(pte, next_pt);
+	pt_entry_changed(paging, pte, was_valid);
+}
+
+static void pt_clear_entry(const struct paging *paging, pt_entry_t pte)
+{
+	bool was_valid = paging->entry_valid(pte);
+
+	paging->clear_entry(pte);
+	pt_entry_changed(paging, pte, was_valid);
+}
+
+static bool pt_empty(page_table_t page_table)
+{
+	return pt_frame(page_table)->pt_entries == 0;
+}
+
+/*
+ * Only the hypervisor's own mappings can be cached in the TLB of this CPU.
+ * Changes to other structures (EPT, VT-d) are invalidated by their owners.
+ */
+static void flush_tlb_range(const struct paging_structures *pg_structs,
+			    unsigned long virt, unsigned long size)
+{
+	unsigned long end = virt + size;
+
+	if (pg_structs != &hv_paging_structs)
+		return;
+
+	if (size / PAGE_SIZE > CONFIG_TLB_FLUSH_THRESHOLD) {
+		arch_tlb_flush_all();
+		return;
+	}
+	for (; virt < end; virt += PAGE_SIZE)
+		arch_tlb_flush_page(virt);
+}
+
+static page_table_t pt_alloc(const struct paging_structures *pg_structs)
+{
+	struct page_cache *cache = pg_structs->cache;
+
+	if (cache && cache->num > 0)
+		return cache->pages[--cache->num];
+	return page_budget_alloc(&mem_pool, pg_structs->budget, 1,
+				 pg_structs->usage);
+}
+
+static int split_hugepage(const struct paging_structures *pg_structs,
+			  const struct paging *paging, pt_entry_t pte,
+			  unsigned long virt, struct pt_flush_batch *batch)
 {
 	unsigned long phys = paging->get_phys(pte, virt);
 	struct paging_structures sub_structs;
@@ -159,32 +701,94 @@ static int split_hugepage(const struct paging *paging, pt_entry_t pte,
 	flags = paging->get_flags(pte);
 
 	sub_structs.root_paging = paging + 1;
-	sub_structs.root_table = page_alloc(&mem_pool, 1);
+	sub_structs.root_table = pt_alloc(pg_structs);
+	sub_structs.usage = pg_structs->usage;
+	sub_structs.budget = pg_structs->budget;
+	sub_structs.cache = pg_structs->cache;
 	if (!sub_structs.root_table)
 		return -ENOMEM;
-	paging->set_next_pt(pte, page_map_hvirt2phys(sub_structs.root_table));
-	flush_pt_entry(pte, coherent);
+	pt_set_next_pt(paging, pte,
+		       page_map_hvirt2phys(sub_structs.root_table));
+	flush_pt_entry(batch, pte);
 
 	return page_map_create(&sub_structs, phys, paging->page_size, virt,
-			       flags, coherent);
+			       flags, batch->coherent);
+}
+
+/*
+ * Merge completely populated page tables whose entries map a contiguous and
+ * suitably aligned physical range with identical flags back into a single
+ * huge page entry of the upper level, repeating this as far up as possible.
+ * ptes holds the entries walked from the root down to the terminal entry at
+ * level n.
+ */
+static void coalesce_hugepages(const struct paging_structures *pg_structs,
+			       const struct paging *paging, pt_entry_t *ptes,
+			       int n, unsigned long virt,
+			       struct pt_flush_batch *batch)
+{
+	const struct paging *upper_paging;
+	unsigned long base, phys, flags, entries, i;
+	page_table_t table;
+	pt_entry_t pte;
+
+	for (; n > 0; n--, paging--) {
+		upper_paging = paging - 1;
+		if (upper_paging->page_size == 0)
+			return;
+
+		table = (page_table_t)((unsigned long)ptes[n] & PAGE_MASK);
+		entries = upper_paging->page_size / paging->page_size;
+		if (pt_frame(table)->pt_entries != entries)
+			return;
+
+		base = virt & ~(upper_paging->page_size - 1);
+		pte = paging->get_entry(table, base);
+		phys = paging->get_phys(pte, base);
+		if (phys == INVALID_PHYS_ADDR ||
+		    (phys & (upper_paging->page_size - 1)) != 0)
+			return;
+		flags = paging->get_flags(pte);
+
+		for (i = 1; i < entries; i++) {
+			pte = paging->get_entry(table,
+						base + i * paging->page_size);
+			if (paging->get_phys(pte, base + i * paging->page_size) !=
+			    phys + i * paging->page_size ||
+			    paging->get_flags(pte) != flags)
+				return;
+		}
+
+		pt_set_terminal(upper_paging, ptes[n - 1], phys, flags);
+		flush_pt_entry(batch, ptes[n - 1]);
+		flush_pt_batch(batch);
+		page_budget_free(&mem_pool, pg_structs->budget, table, 1);
+	}
 }
 
 int page_map_create(const struct paging_structures *pg_structs,
 		    unsigned long phys, unsigned long size, unsigned long virt,
 		    unsigned long flags, enum page_map_coherent coherent)
 {
+	struct pt_flush_batch batch = { .coherent = coherent };
+	unsigned long virt_start, size_total;
+	int err = 0;
+
 	phys &= PAGE_MASK;
 	virt &= PAGE_MASK;
 	size = PAGE_ALIGN(size);
 
+	virt_start = virt;
+	size_total = size;
+
 	while (size > 0) {
 		const struct paging *paging = pg_structs->root_paging;
 		page_table_t pt = pg_structs->root_table;
-		pt_entry_t pte;
-		int err;
+		pt_entry_t pte, ptes[MAX_PAGE_DIR_LEVELS];
+		int n = 0;
 
 		while (1) {
-			pte = paging->get_entry(pt, virt);
+			pte = ptes[n] = paging->get_entry(pt, virt);
 			if (paging->page_size > 0 &&
 			    paging->page_size <= size &&
 			    ((phys | virt) & (paging->page_size - 1)) == 0) {
@@ -192,55 +796,83 @@ int page_map_create(const struct paging_structures *pg_structs,
 				 * We might be overwriting a more fine-grained
 				 * mapping, so release it first. This cannot
 				 * fail as we are working along hugepage
-				 * boundaries.
+				 * boundaries. As this may release the tables
+				 * walked so far, walk down again afterwards.
 				 */
-				if (paging->page_size > PAGE_SIZE)
+				if (paging->page_size > PAGE_SIZE &&
+				    paging->entry_valid(pte)) {
 					page_map_destroy(pg_structs, virt,
 							 paging->page_size,
 							 coherent);
-				paging->set_terminal(pte, phys, flags);
-				flush_pt_entry(pte, coherent);
+					paging = pg_structs->root_paging;
+					pt = pg_structs->root_table;
+					n = 0;
+					continue;
+				}
+				pt_set_terminal(paging, pte, phys, flags);
+				flush_pt_entry(&batch, pte);
+				/*
+				 * The hypervisor's own mappings are left alone,
+				 * the temporary mapping region relies on its
+				 * preallocated page tables.
+				 */
+				if (pg_structs != &hv_paging_structs)
+					coalesce_hugepages(pg_structs, paging,
+							   ptes, n, virt,
+							   &batch);
 				break;
 			}
 			if (paging->entry_valid(pte)) {
-				err = split_hugepage(paging, pte, virt,
-						     coherent);
+				err = split_hugepage(pg_structs, paging, pte,
+						     virt, &batch);
 				if (err)
-					return err;
+					goto out;
 				pt = page_map_phys2hvirt(
 						paging->get_next_pt(pte));
 			} else {
-				pt = page_alloc(&mem_pool, 1);
-				if (!pt)
-					return -ENOMEM;
-				paging->set_next_pt(pte,
-						    page_map_hvirt2phys(pt));
-				flush_pt_entry(pte, coherent);
+				pt = pt_alloc(pg_structs);
+				if (!pt) {
+					err = -ENOMEM;
+					goto out;
+				}
+				pt_set_next_pt(paging, pte,
+					       page_map_hvirt2phys(pt));
+				flush_pt_entry(&batch, pte);
 			}
 			paging++;
+			n++;
 		}
-		arch_tlb_flush_page(virt);
 
 		phys += paging->page_size;
 		virt += paging->page_size;
 		size -= paging->page_size;
 	}
-	return 0;
+
+out:
+	flush_pt_batch(&batch);
+	flush_tlb_range(pg_structs, virt_start, size_total);
+	return err;
 }
 
 int page_map_destroy(const struct paging_structures *pg_structs,
 		     unsigned long virt, unsigned long size,
 		     enum page_map_coherent coherent)
 {
+	struct pt_flush_batch batch = { .coherent = coherent };
+	unsigned long virt_start, size_total;
+	int err = 0;
+
 	size = PAGE_ALIGN(size);
 
+	virt_start = virt;
+	size_total = size;
+
 	while (size > 0) {
 		const struct paging *paging = pg_structs->root_paging;
 		page_table_t pt[MAX_PAGE_DIR_LEVELS];
 		unsigned long page_size;
 		pt_entry_t pte;
 		int n = 0;
-		int err;
 
 		/* walk down the page table, saving intermediate tables */
 		pt[0] = pg_structs->root_table;
@@ -250,10 +882,10 @@ int page_map_destroy(const struct paging_structures *pg_structs,
 				break;
 			if (paging->get_phys(pte, virt) != INVALID_PHYS_ADDR) {
 				if (paging->page_size > size) {
-					err = split_hugepage(paging, pte, virt,
-							     coherent);
+					err = split_hugepage(pg_structs, paging,
+							     pte, virt, &batch);
 					if (err)
-						return err;
+						goto out;
 				} else
 					break;
 			}
@@ -266,22 +898,164 @@ int page_map_destroy(const struct paging_structures *pg_structs,
 
 		/* walk up again, clearing entries, releasing empty tables */
 		while (1) {
-			paging->clear_entry(pte);
-			flush_pt_entry(pte, coherent);
-			if (n == 0 || !paging->page_table_empty(pt[n]))
+			pt_clear_entry(paging, pte);
+			flush_pt_entry(&batch, pte);
+			if (n == 0 || !pt_empty(pt[n]))
 				break;
-			page_free(&mem_pool, pt[n], 1);
+			/* entries must hit memory before the table is reused */
+			flush_pt_batch(&batch);
+			page_budget_free(&mem_pool, pg_structs->budget,
+					 pt[n], 1);
 			paging--;
 			pte = paging->get_entry(pt[--n], virt);
 		}
-		arch_tlb_flush_page(virt);
 
 		if (page_size > size)
 			break;
 		virt += page_size;
 		size -= page_size;
 	}
-	return 0;
+
+out:
+	flush_pt_batch(&batch);
+	flush_tlb_range(pg_structs, virt_start, size_total);
+	return err;
+}
+
+/* Returns the address at which a table walked for the TLB entry is mapped. */
+/*
+ * Returns the table below the root table entry that covers virt, creating it
+ * if the entry is still invalid. Mappings below distinct root table entries
+ * can then be created in parallel, using structures that are rooted at these
+ * tables. Returns NULL if the entry maps a page or no table is available.
+ */
+page_table_t page_map_root_subtable(const struct paging_structures *pg_structs,
+				    unsigned long virt,
+				    enum page_map_coherent coherent)
+{
+	const struct paging *paging = pg_structs->root_paging;
+	pt_entry_t pte = paging->get_entry(pg_structs->root_table, virt);
+	page_table_t pt;
+
+	if (paging->entry_valid(pte)) {
+		if (paging->get_phys(pte, virt) != INVALID_PHYS_ADDR)
+			return NULL;
+		return page_map_phys2hvirt(paging->get_next_pt(pte));
+	}
+
+	pt = pt_alloc(pg_structs);
+	if (!pt)
+		return NULL;
+	pt_set_next_pt(paging, pte, page_map_hvirt2phys(pt));
+	if (coherent == PAGE_MAP_COHERENT)
+		flush_cache(pte, sizeof(*pte));
+
+	return pt;
+}
+
+static page_table_t guest_tlb_table(struct per_cpu *cpu_data,
+				    struct guest_tlb_entry *entry,
+				    unsigned int level)
+{
+	unsigned int slot = (entry - cpu_data->guest_tlb.entry) *
+		GUEST_TLB_MAX_LEVELS + level;
+
+	return (page_table_t)(GUEST_TLB_MAPPING_CPU_BASE(cpu_data) +
+			      slot * PAGE_SIZE);
+}
+
+static struct guest_tlb_entry *
+guest_tlb_lookup(struct per_cpu *cpu_data,
+		 const struct guest_paging_structures *pg_structs,
+		 unsigned long virt)
+{
+	struct guest_tlb *tlb = &cpu_data->guest_tlb;
+	const struct paging *paging;
+	struct guest_tlb_entry *entry;
+	unsigned int n, level;
+	pt_entry_t pte;
+
+	virt &= PAGE_MASK;
+
+	for (n = 0, entry = tlb->entry; n < GUEST_TLB_ENTRIES; n++, entry++) {
+		if (entry->generation != tlb->generation ||
+		    entry->root_paging != pg_structs->root_paging ||
+		    entry->root_table_gphys != pg_structs->root_table_gphys ||
+		    entry->virt != virt)
+			continue;
+
+		/*
+		 * Guests can modify their page tables without us noticing, so
+		 * check that every entry of the cached walk is still in place.
+		 * The tables are still mapped, this only reads one entry per
+		 * level instead of performing the EPT lookups of a full walk.
+		 */
+		paging = entry->root_paging;
+		for (level = 0; level < entry->levels; level++, paging++) {
+			pte = paging->get_entry(guest_tlb_table(cpu_data, entry,
+								level),
+						virt);
+			if (!paging->entry_valid(pte))
+				goto stale;
+			if (level == entry->levels - 1) {
+				if ((paging->get_phys(pte, virt) & PAGE_MASK) !=
+				    entry->gphys)
+					goto stale;
+			} else if (paging->get_phys(pte, virt) !=
+				   INVALID_PHYS_ADDR ||
+				   paging->get_next_pt(pte) !=
+				   entry->next_table_gphys[level]) {
+				goto stale;
+			}
+		}
+		return entry;
+	}
+	return NULL;
+
+stale:
+	entry->root_paging = NULL;
+	return NULL;
+}
+
+/*
+ * Picks the entry to be replaced. It is invalidated right away because a walk
+ * maps the guest page tables at its slots.
+ */
+static struct guest_tlb_entry *guest_tlb_victim(struct per_cpu *cpu_data)
+{
+	struct guest_tlb *tlb = &cpu_data->guest_tlb;
+	struct guest_tlb_entry *entry = &tlb->entry[tlb->next_victim];
+
+	entry->root_paging = NULL;
+	return entry;
+}
+
+static void guest_tlb_insert(struct per_cpu *cpu_data,
+			     struct guest_tlb_entry *entry,
+			     const struct guest_paging_structures *pg_structs,
+			     unsigned long virt, unsigned long gphys,
+			     unsigned long phys, unsigned int levels)
+{
+	struct guest_tlb *tlb = &cpu_data->guest_tlb;
+
+	tlb->next_victim = (tlb->next_victim + 1) % GUEST_TLB_ENTRIES;
+
+	entry->root_paging = pg_structs->root_paging;
+	entry->root_table_gphys = pg_structs->root_table_gphys;
+	entry->virt = virt & PAGE_MASK;
+	entry->gphys = gphys & PAGE_MASK;
+	entry->phys = phys & PAGE_MASK;
+	entry->levels = levels;
+	entry->generation = tlb->generation;
+}
+
+/*
+ * Has to be called when the guest paging mode or the cell's memory mappings
+ * change.
+ */
+void page_map_guest_tlb_flush(struct per_cpu *cpu_data)
+{
+	cpu_data->guest_tlb.generation++;
 }
 
 void *page_map_get_guest_page(struct per_cpu *cpu_data,
@@ -291,39 +1065,53 @@ void *page_map_get_guest_page(struct per_cpu *cpu_data,
 	unsigned long page_table_gphys = pg_structs->root_table_gphys;
 	const struct paging *paging = pg_structs->root_paging;
 	unsigned long page_virt, phys, gphys;
+	struct guest_tlb_entry *tlb_entry;
+	unsigned int levels = 0;
+	page_table_t table;
 	pt_entry_t pte;
 	int err;
 
-	page_virt = TEMPORARY_MAPPING_BASE +
-		cpu_data->cpu_id * PAGE_SIZE * NUM_TEMPORARY_PAGES;
+	tlb_entry = guest_tlb_lookup(cpu_data, pg_structs, virt);
+	if (tlb_entry) {
+		phys = tlb_entry->phys;
+		goto map_page;
+	}
 
+	tlb_entry = guest_tlb_victim(cpu_data);
 	while (1) {
 		/* map guest page table */
 		phys = arch_page_map_gphys2phys(cpu_data, page_table_gphys);
 		if (phys == INVALID_PHYS_ADDR)
 			return NULL;
+		table = guest_tlb_table(cpu_data, tlb_entry, levels);
 		err = page_map_create(&hv_paging_structs, phys,
-				      PAGE_SIZE, page_virt,
+				      PAGE_SIZE, (unsigned long)table,
 				      PAGE_READONLY_FLAGS,
 				      PAGE_MAP_NON_COHERENT);
 		if (err)
 			return NULL;
 
 		/* evaluate page table entry */
-		pte = paging->get_entry((page_table_t)page_virt, virt);
+		pte = paging->get_entry(table, virt);
 		if (!paging->entry_valid(pte))
 			return NULL;
 		gphys = paging->get_phys(pte, virt);
 		if (gphys != INVALID_PHYS_ADDR)
 			break;
 		page_table_gphys = paging->get_next_pt(pte);
+		tlb_entry->next_table_gphys[levels++] = page_table_gphys;
 		paging++;
 	}
 
 	phys = arch_page_map_gphys2phys(cpu_data, gphys);
 	if (phys == INVALID_PHYS_ADDR)
 		return NULL;
+	guest_tlb_insert(cpu_data, tlb_entry, pg_structs, virt, gphys, phys,
+			 levels + 1);
+
+map_page:
 	/* map guest page */
+	page_virt = TEMPORARY_MAPPING_CPU_BASE(cpu_data);
 	err = page_map_create(&hv_paging_structs, phys, PAGE_SIZE, page_virt,
 			      flags, PAGE_MAP_NON_COHERENT);
 	if (err)
@@ -334,7 +1122,7 @@ void *page_map_get_guest_page(struct per_cpu *cpu_data,
 
 int paging_init(void)
 {
-	unsigned long per_cpu_pages, config_pages, bitmap_pages;
+	unsigned long per_cpu_pages, config_pages, bitmap_pages, frame_pages;
 	unsigned long n;
 	int err;
 
@@ -352,29 +1140,44 @@ int paging_init(void)
 	mem_pool.pages = (system_config->hypervisor_memory.size -
 		(__page_pool - (u8 *)&hypervisor_header)) / PAGE_SIZE;
 	bitmap_pages = (mem_pool.pages + BITS_PER_PAGE - 1) / BITS_PER_PAGE;
+	frame_pages = (mem_pool.pages * sizeof(struct page_frame) +
+		       PAGE_SIZE - 1) / PAGE_SIZE;
 
-	if (mem_pool.pages <= per_cpu_pages + config_pages + bitmap_pages)
+	if (mem_pool.pages <=
+	    per_cpu_pages + config_pages + bitmap_pages + frame_pages)
 		goto error_nomem;
 
 	mem_pool.base_address = __page_pool;
 	mem_pool.used_bitmap =
 		(unsigned long *)(__page_pool + per_cpu_pages * PAGE_SIZE +
 				  config_pages * PAGE_SIZE);
-	mem_pool.used_pages = per_cpu_pages + config_pages + bitmap_pages;
+	mem_pool.frames = (struct page_frame *)
+		((u8 *)mem_pool.used_bitmap + bitmap_pages * PAGE_SIZE);
+	mem_pool.used_pages =
+		per_cpu_pages + config_pages + bitmap_pages + frame_pages;
+	mem_pool.usage_pages[PAGE_USAGE_OTHER] = mem_pool.used_pages;
 	for (n = 0; n < mem_pool.used_pages; n++)
-		set_bit(n, mem_pool.used_bitmap);
-	mem_pool.flags = PAGE_SCRUB_ON_FREE;
+		mark_page_used(&mem_pool, n);
+	for (n = 0; n <= PAGE_POOL_MAX_ORDER; n++)
+		mem_pool.free_list[n] = FRAME_LIST_END;
+	mem_pool.dirty_list = FRAME_LIST_END;
+	buddy_free_range(&mem_pool, mem_pool.used_pages,
+			 mem_pool.pages - mem_pool.used_pages);
+	mem_pool.flags = PAGE_SCRUB_FREED;
 
-	remap_pool.used_bitmap = page_alloc(&mem_pool, NUM_REMAP_BITMAP_PAGES);
+	remap_pool.used_bitmap = page_alloc(&mem_pool, NUM_REMAP_BITMAP_PAGES,
+					    PAGE_USAGE_OTHER);
 	remap_pool.used_pages =
-		hypervisor_header.possible_cpus * NUM_TEMPORARY_PAGES;
+		hypervisor_header.possible_cpus * NUM_CPU_MAPPING_PAGES;
 	for (n = 0; n < remap_pool.used_pages; n++)
-		set_bit(n, remap_pool.used_bitmap);
+		mark_page_used(&remap_pool, n);
 
 	arch_paging_init();
 
 	hv_paging_structs.root_paging = hv_paging;
-	hv_paging_structs.root_table = page_alloc(&mem_pool, 1);
+	hv_paging_structs.root_table = page_alloc(&mem_pool, 1,
+						  PAGE_USAGE_HV_PT);
+	hv_paging_structs.usage = PAGE_USAGE_HV_PT;
 	if (!hv_paging_structs.root_table)
 		goto error_nomem;
 
@@ -408,4 +1211,18 @@ void page_map_dump_stats(const char *when)
 	printk("Page pool usage %s: mem %d/%d, remap %d/%d\n", when,
 	       mem_pool.used_pages, mem_pool.pages,
 	       remap_pool.used_pages, remap_pool.pages);
+	printk("Page allocation cycles: mem %lu calls, %lu total, %lu max; "
+	       "remap %lu calls, %lu total, %lu max\n",
+	       mem_pool.alloc_calls, mem_pool.alloc_cycles,
+	       mem_pool.alloc_max_cycles, remap_pool.alloc_calls,
+	       remap_pool.alloc_cycles, remap_pool.alloc_max_cycles);
+	printk("Page pool mem: peak %lu, largest free %lu, failures %lu; "
+	       "used for hv pt %lu, cell pt %lu, iommu pt %lu, cells %lu, "
+	       "cpu sets %lu\n",
+	       mem_pool.peak_used_pages, page_pool_largest_free(&mem_pool),
+	       mem_pool.alloc_failures, mem_pool.usage_pages[PAGE_USAGE_HV_PT],
+	       mem_pool.usage_pages[PAGE_USAGE_CELL_PT],
+	       mem_pool.usage_pages[PAGE_USAGE_IOMMU_PT],
+	       mem_pool.usage_pages[PAGE_USAGE_CELL],
+	       mem_pool.usage_pages[PAGE_USAGE_CPU_SET]);
 }
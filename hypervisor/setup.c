@@ -61,7 +61,8 @@ static void init_early(unsigned int cpu_id)
 	if (system_config->config_memory.size > 0) {
 		size = PAGE_ALIGN(system_config->config_memory.size);
 
-		config_memory = page_alloc(&remap_pool, size / PAGE_SIZE);
+		config_memory = page_alloc(&remap_pool, size / PAGE_SIZE,
+					   PAGE_USAGE_OTHER);
 		if (!config_memory) {
 			error = -ENOMEM;
 			return;
@@ -79,14 +80,21 @@ static void init_early(unsigned int cpu_id)
 	if (error)
 		return;
 
+	/* the root cell remaps depend on other cells, so it is not limited */
+	root_cell.page_budget.strict = false;
+	error = page_budget_grow(&mem_pool, &root_cell.page_budget,
+				 arch_cell_page_budget(root_cell.config));
+	if (error)
+		return;
+
 	error = arch_init_early(&root_cell);
 	if (error)
 		return;
 
-	root_cell.id = -1;
 	error = cell_init(&root_cell, false);
 	if (error)
 		return;
+	cell_register(&root_cell);
 
 	/*
 	 * Back the region of the hypervisor core and per-CPU page with empty
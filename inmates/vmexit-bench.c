@@ -0,0 +1,79 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2013
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+/*
+ * Measures the round-trip time of VM exits as seen by the guest. Runs in the
+ * tiny-demo cell and reports via its serial port.
+ */
+
+#include <inmate.h>
+#include <jailhouse/hypercall.h>
+
+#ifdef CONFIG_UART_OXPCIE952
+#define UART_BASE		0xe000
+#else
+#define UART_BASE		0x2f8
+#endif
+
+#define ROUNDS			100000
+
+static inline unsigned long read_tsc(void)
+{
+	unsigned int lo, hi;
+
+	asm volatile("rdtsc" : "=a" (lo), "=d" (hi));
+	return lo | ((unsigned long)hi << 32);
+}
+
+static void exit_cpuid(void)
+{
+	unsigned int eax = 0, ebx, ecx = 0, edx;
+
+	asm volatile("cpuid"
+		: "+a" (eax), "=b" (ebx), "+c" (ecx), "=d" (edx)
+		: : "memory");
+}
+
+static void exit_hypercall(void)
+{
+	/* rejected for non-root cells, but takes the full hypercall path */
+	jailhouse_call1(JAILHOUSE_HC_CELL_GET_STATE, 0);
+}
+
+static void measure(const char *name, void (*trigger_exit)(void))
+{
+	unsigned long start, cycles, min = ~0UL, max = 0, total = 0;
+	int n;
+
+	for (n = 0; n < ROUNDS; n++) {
+		start = read_tsc();
+		trigger_exit();
+		cycles = read_tsc() - start;
+
+		total += cycles;
+		if (cycles < min)
+			min = cycles;
+		if (cycles > max)
+			max = cycles;
+	}
+
+	printk("%s: avg %6lu, min %6lu, max %8lu cycles\n", name,
+	       total / ROUNDS, min, max);
+}
+
+void inmate_main(void)
+{
+	printk_uart_base = UART_BASE;
+	printk("VM exit benchmark, %d rounds per exit type\n", ROUNDS);
+
+	measure("CPUID    ", exit_cpuid);
+	measure("hypercall", exit_hypercall);
+
+	asm volatile("hlt");
+}
@@ -33,7 +33,33 @@ struct jailhouse_cell {
 	__u32 config_size;
 };
 
+#define JAILHOUSE_CELL_RESTORE_IMAGES	0x0001
+
+/* A config_address of 0 selects the root cell as target. */
+struct jailhouse_cpu_move {
+	__u64 config_address;
+	__u32 config_size;
+	__u32 cpu;
+};
+
+struct jailhouse_cell_mem {
+	__u64 config_address;
+	__u32 config_size;
+	__u32 padding;
+	struct jailhouse_memory region;
+};
+
+struct jailhouse_cell_start {
+	__u64 config_address;
+	__u32 config_size;
+	__u32 flags;
+};
+
 #define JAILHOUSE_ENABLE		_IOW(0, 0, struct jailhouse_system)
 #define JAILHOUSE_DISABLE		_IO(0, 1)
 #define JAILHOUSE_CELL_CREATE		_IOW(0, 2, struct jailhouse_new_cell)
 #define JAILHOUSE_CELL_DESTROY		_IOW(0, 3, struct jailhouse_cell)
+#define JAILHOUSE_CELL_START		_IOW(0, 4, struct jailhouse_cell_start)
+#define JAILHOUSE_CELL_MEM_ATTACH	_IOW(0, 5, struct jailhouse_cell_mem)
+#define JAILHOUSE_CELL_MEM_DETACH	_IOW(0, 6, struct jailhouse_cell_mem)
+#define JAILHOUSE_CPU_MOVE		_IOW(0, 7, struct jailhouse_cpu_move)
@@ -0,0 +1,18 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2013
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+/*
+ * Used to build the generic string functions of lib.c next to the
+ * architecture's, so that both can be compared.
+ */
+
+#ifndef _JAILHOUSE_ASM_STRING_H
+#define _JAILHOUSE_ASM_STRING_H
+
+#endif /* !_JAILHOUSE_ASM_STRING_H */
@@ -0,0 +1,105 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2013
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "host.h"
+
+#define CAPTURE_SIZE	1024
+
+static int memory_fd = -1;
+static char capture_buf[CAPTURE_SIZE];
+static size_t capture_len;
+static int capturing;
+
+int host_memory_init(void *base, unsigned long size)
+{
+	memory_fd = memfd_create("jailhouse-test", 0);
+	if (memory_fd < 0 || ftruncate(memory_fd, size) < 0) {
+		perror("memfd");
+		return -1;
+	}
+	if (mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+		 memory_fd, 0) == MAP_FAILED) {
+		perror("mmap");
+		return -1;
+	}
+	return 0;
+}
+
+void host_map_page(unsigned long virt, unsigned long offset)
+{
+	void *addr = (void *)virt;
+	void *res;
+
+	/* populate right away so that faults count as emulation overhead */
+	if (offset == ~0UL)
+		res = mmap(addr, getpagesize(), PROT_NONE,
+			   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+	else
+		res = mmap(addr, getpagesize(), PROT_READ | PROT_WRITE,
+			   MAP_SHARED | MAP_FIXED | MAP_POPULATE, memory_fd,
+			   offset);
+	if (res == MAP_FAILED) {
+		perror("mmap");
+		abort();
+	}
+}
+
+void host_write(const char *msg)
+{
+	size_t len = strlen(msg);
+
+	if (!capturing) {
+		fputs(msg, stdout);
+		return;
+	}
+	if (len > CAPTURE_SIZE - 1 - capture_len)
+		len = CAPTURE_SIZE - 1 - capture_len;
+	memcpy(capture_buf + capture_len, msg, len);
+	capture_len += len;
+	capture_buf[capture_len] = 0;
+}
+
+void host_capture_start(void)
+{
+	capture_len = 0;
+	capture_buf[0] = 0;
+	capturing = 1;
+}
+
+const char *host_capture_end(void)
+{
+	capturing = 0;
+	return capture_buf;
+}
+
+void host_abort(void)
+{
+	fflush(stdout);
+	abort();
+}
+
+int main(int argc, char *argv[])
+{
+	int bench = argc > 1 && strcmp(argv[1], "bench") == 0;
+
+	if (argc > 1 && !bench) {
+		fprintf(stderr, "usage: %s [bench]\n", argv[0]);
+		return 2;
+	}
+
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	return harness_main(bench);
+}
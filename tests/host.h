@@ -0,0 +1,33 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2013
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+/*
+ * Services of the Linux process the hypervisor core runs in. This header is
+ * shared by host.c, built against the C library, and the test code, built
+ * against the hypervisor headers, so it may only use plain C types.
+ */
+
+#ifndef _JAILHOUSE_TESTS_HOST_H
+#define _JAILHOUSE_TESTS_HOST_H
+
+/* backs the given page-aligned range with a shared memory file */
+int host_memory_init(void *base, unsigned long size);
+/* maps the memory file at the given offset to virt, or unmaps virt if the
+ * offset is ~0UL */
+void host_map_page(unsigned long virt, unsigned long offset);
+
+void host_write(const char *msg);
+void host_capture_start(void);
+const char *host_capture_end(void);
+
+void __attribute__((noreturn)) host_abort(void);
+
+int harness_main(int bench);
+
+#endif /* !_JAILHOUSE_TESTS_HOST_H */
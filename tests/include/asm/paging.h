@@ -0,0 +1,36 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2013
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+/*
+ * Wraps the architecture's paging header, replacing the privileged TLB and
+ * cache maintenance by the harness implementations in stubs.c.
+ */
+
+#ifndef _JAILHOUSE_TESTS_ASM_PAGING_H
+#define _JAILHOUSE_TESTS_ASM_PAGING_H
+
+#define arch_tlb_flush_all	__arch_tlb_flush_all
+#define arch_tlb_flush_page	__arch_tlb_flush_page
+#define flush_cache		__flush_cache
+
+#include_next <asm/paging.h>
+
+#undef arch_tlb_flush_all
+#undef arch_tlb_flush_page
+#undef flush_cache
+
+#ifndef __ASSEMBLY__
+
+void arch_tlb_flush_all(void);
+void arch_tlb_flush_page(unsigned long addr);
+void flush_cache(void *addr, long size);
+
+#endif /* !__ASSEMBLY__ */
+
+#endif /* !_JAILHOUSE_TESTS_ASM_PAGING_H */
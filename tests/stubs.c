@@ -0,0 +1,169 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2013
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+/*
+ * Hosts the hypervisor core in a Linux process. The hypervisor memory is
+ * emulated by a shared memory file that is mapped where the linker placed
+ * hypervisor_header and the page pool. Temporary mappings are made real by
+ * mapping the same file at the remap area whenever paging.c flushes the TLB
+ * for them.
+ */
+
+#include <jailhouse/control.h>
+#include <jailhouse/entry.h>
+#include <jailhouse/hypercall.h>
+#include <jailhouse/paging.h>
+#include <jailhouse/printk.h>
+#include <jailhouse/processor.h>
+#include <asm/percpu.h>
+
+#include "host.h"
+#include "test.h"
+
+asm(".section .bss.hypervisor,\"aw\",@nobits\n\t"
+    ".balign 4096\n\t"
+    ".globl hypervisor_header\n"
+    "hypervisor_header:\n\t"
+    ".skip 4096\n\t"
+    ".globl __page_pool\n"
+    "__page_pool:\n\t"
+    ".skip " __stringify(TEST_HV_SIZE) " - 4096\n\t"
+    ".previous");
+
+extern u8 __page_pool[];
+
+struct jailhouse_system *system_config;
+
+unsigned int test_checks, test_failures;
+unsigned long test_emulation_cycles;
+unsigned long test_tlb_flushes;
+
+struct paging_structures test_gphys_structs;
+
+/* host mapping of each temporary page, to skip redundant remapping */
+static unsigned long temporary_offset[NUM_CPU_MAPPING_PAGES];
+
+int phys_processor_id(void)
+{
+	return 0;
+}
+
+void arch_dbg_write(const char *msg)
+{
+	host_write(msg);
+}
+
+void panic_stop(struct per_cpu *cpu_data)
+{
+	printk("FATAL: panic_stop called\n");
+	host_abort();
+}
+
+static bool is_temporary_mapping(unsigned long virt)
+{
+	/* a single CPU is emulated */
+	return virt >= TEMPORARY_MAPPING_BASE &&
+		virt < TEMPORARY_MAPPING_BASE +
+		NUM_CPU_MAPPING_PAGES * PAGE_SIZE;
+}
+
+static void sync_temporary_mapping(unsigned long virt)
+{
+	unsigned long phys = page_map_virt2phys(&hv_paging_structs, virt);
+	unsigned long *offset =
+		&temporary_offset[(virt - TEMPORARY_MAPPING_BASE) / PAGE_SIZE];
+
+	if (phys >= TEST_HV_PHYS && phys < TEST_HV_PHYS + TEST_HV_SIZE)
+		phys = (phys & PAGE_MASK) - TEST_HV_PHYS;
+	else
+		phys = ~0UL;
+	if (*offset != phys) {
+		host_map_page(virt, phys);
+		*offset = phys;
+	}
+}
+
+void arch_tlb_flush_all(void)
+{
+	unsigned long start = get_cycles();
+	unsigned long virt;
+
+	test_tlb_flushes++;
+	for (virt = TEMPORARY_MAPPING_BASE; is_temporary_mapping(virt);
+	     virt += PAGE_SIZE)
+		sync_temporary_mapping(virt);
+	test_emulation_cycles += get_cycles() - start;
+}
+
+void arch_tlb_flush_page(unsigned long addr)
+{
+	unsigned long start = get_cycles();
+
+	test_tlb_flushes++;
+	if (is_temporary_mapping(addr))
+		sync_temporary_mapping(addr & PAGE_MASK);
+	test_emulation_cycles += get_cycles() - start;
+}
+
+void flush_cache(void *addr, long size)
+{
+}
+
+X86_64_DEFINE_VIRT2PHYS(gphys_virt2phys, 4)
+
+/* like the EPT walk of vmx.c */
+unsigned long arch_page_map_gphys2phys(struct per_cpu *cpu_data,
+				       unsigned long gphys)
+{
+	return gphys_virt2phys(test_gphys_structs.root_table, gphys);
+}
+
+int harness_main(int bench)
+{
+	struct jailhouse_system *config;
+	unsigned int n;
+
+	if (host_memory_init(&hypervisor_header, TEST_HV_SIZE))
+		return 1;
+	for (n = 0; n < NUM_CPU_MAPPING_PAGES; n++)
+		temporary_offset[n] = ~0UL;
+
+	hypervisor_header.possible_cpus = 1;
+	hypervisor_header.online_cpus = 1;
+
+	/*
+	 * paging_init expects the system configuration behind the per-CPU
+	 * data and derives page_offset from JAILHOUSE_BASE. Choose the start
+	 * address so that the hypervisor memory appears at TEST_HV_PHYS.
+	 */
+	config = (struct jailhouse_system *)(__page_pool +
+					     sizeof(struct per_cpu));
+	config->hypervisor_memory.phys_start = JAILHOUSE_BASE -
+		(unsigned long)&hypervisor_header + TEST_HV_PHYS;
+	config->hypervisor_memory.size = TEST_HV_SIZE;
+
+	if (paging_init())
+		return 1;
+
+	test_paging();
+	test_lib();
+	test_printk();
+
+	printk("%u checks, %u failures\n", test_checks, test_failures);
+	if (test_failures)
+		return 1;
+
+	if (bench) {
+		bench_paging();
+		bench_lib();
+		bench_printk();
+	}
+
+	return 0;
+}
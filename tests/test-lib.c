@@ -0,0 +1,166 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2013
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include <jailhouse/printk.h>
+#include <jailhouse/string.h>
+
+#include "test.h"
+
+#define MAX_SIZE	70
+#define BENCH_BUF_SIZE	8192
+
+/* lib.c built without the architecture's string functions */
+void *generic_memcpy(void *d, const void *s, unsigned long n);
+void *generic_memset(void *s, int c, unsigned long n);
+int generic_memcmp(const void *s1, const void *s2, unsigned long n);
+
+static u8 src[MAX_SIZE + 16], dst[MAX_SIZE + 16], ref[MAX_SIZE + 16];
+static u8 bench_src[BENCH_BUF_SIZE], bench_dst[BENCH_BUF_SIZE];
+
+static void fill(u8 *buf, unsigned int seed)
+{
+	unsigned int n;
+
+	for (n = 0; n < sizeof(src); n++)
+		buf[n] = seed + n * 7;
+}
+
+static bool equal(const u8 *a, const u8 *b)
+{
+	unsigned int n;
+
+	for (n = 0; n < sizeof(src); n++)
+		if (a[n] != b[n])
+			return false;
+	return true;
+}
+
+static void byte_memcpy(u8 *d, const u8 *s, unsigned long n)
+{
+	while (n-- > 0)
+		*d++ = *s++;
+}
+
+static void byte_memset(u8 *s, int c, unsigned long n)
+{
+	while (n-- > 0)
+		*s++ = c;
+}
+
+static int sign(int val)
+{
+	return val < 0 ? -1 : val > 0;
+}
+
+static void test_copy(void *(*copy)(void *, const void *, unsigned long),
+		      unsigned int size, unsigned int soffs, unsigned int doffs)
+{
+	fill(src, 1);
+	fill(dst, 2);
+	fill(ref, 2);
+	byte_memcpy(ref + doffs, src + soffs, size);
+	CHECK(copy(dst + doffs, src + soffs, size) == dst + doffs);
+	CHECK(equal(dst, ref));
+}
+
+static void test_set(void *(*set)(void *, int, unsigned long),
+		     unsigned int size, unsigned int offs)
+{
+	fill(dst, 3);
+	fill(ref, 3);
+	byte_memset(ref + offs, 0x5a, size);
+	CHECK(set(dst + offs, 0x15a, size) == dst + offs);
+	CHECK(equal(dst, ref));
+}
+
+static void test_compare(int (*compare)(const void *, const void *,
+					unsigned long),
+			 unsigned int size, unsigned int offs)
+{
+	fill(src, 4);
+	byte_memcpy(dst + offs, src + offs, size);
+	CHECK(compare(dst + offs, src + offs, size) == 0);
+	if (size == 0)
+		return;
+	/* a difference in the last byte, bytes compare unsigned */
+	dst[offs + size - 1] = src[offs + size - 1] ^ 0x80;
+	CHECK(sign(compare(dst + offs, src + offs, size)) ==
+	      sign(dst[offs + size - 1] - src[offs + size - 1]));
+	/* an earlier difference takes precedence */
+	dst[offs] = src[offs] + 1;
+	if (dst[offs] != 0)
+		CHECK(compare(dst + offs, src + offs, size) > 0);
+}
+
+void test_lib(void)
+{
+	unsigned int size, soffs, doffs;
+
+	for (size = 0; size <= MAX_SIZE; size++)
+		for (soffs = 0; soffs < 8; soffs++) {
+			for (doffs = 0; doffs < 8; doffs++) {
+				test_copy(memcpy, size, soffs, doffs);
+				test_copy(generic_memcpy, size, soffs, doffs);
+			}
+			test_set(memset, size, soffs);
+			test_set(generic_memset, size, soffs);
+			test_compare(memcmp, size, soffs);
+			test_compare(generic_memcmp, size, soffs);
+		}
+
+	CHECK(strcmp("", "") == 0);
+	CHECK(strcmp("jailhouse", "jailhouse") == 0);
+	CHECK(strcmp("jailhouse", "jail") > 0);
+	CHECK(strcmp("jail", "jailhouse") < 0);
+	CHECK(strcmp("cell", "celL") > 0);
+}
+
+static void bench_size(unsigned long size)
+{
+	unsigned long start, n;
+
+	start = BENCH_START();
+	for (n = 0; n < 10000; n++)
+		byte_memcpy(bench_dst, bench_src, size);
+	printk("%5lu bytes: byte loop copy %6lu, ", size,
+	       BENCH_END(start) / 10000);
+
+	start = BENCH_START();
+	for (n = 0; n < 10000; n++)
+		generic_memcpy(bench_dst, bench_src, size);
+	printk("generic memcpy %6lu, ", BENCH_END(start) / 10000);
+
+	start = BENCH_START();
+	for (n = 0; n < 10000; n++)
+		memcpy(bench_dst, bench_src, size);
+	printk("arch memcpy %6lu cycles\n", BENCH_END(start) / 10000);
+
+	start = BENCH_START();
+	for (n = 0; n < 10000; n++)
+		byte_memset(bench_dst, 0, size);
+	printk("%5lu bytes: byte loop set  %6lu, ", size,
+	       BENCH_END(start) / 10000);
+
+	start = BENCH_START();
+	for (n = 0; n < 10000; n++)
+		generic_memset(bench_dst, 0, size);
+	printk("generic memset %6lu, ", BENCH_END(start) / 10000);
+
+	start = BENCH_START();
+	for (n = 0; n < 10000; n++)
+		memset(bench_dst, 0, size);
+	printk("arch memset %6lu cycles\n", BENCH_END(start) / 10000);
+}
+
+void bench_lib(void)
+{
+	bench_size(64);
+	bench_size(4096);
+	bench_size(8192);
+}
@@ -0,0 +1,518 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2013
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include <jailhouse/entry.h>
+#include <jailhouse/paging.h>
+#include <jailhouse/printk.h>
+#include <jailhouse/string.h>
+#include <asm/percpu.h>
+
+#include "test.h"
+
+#define GUEST_RAM		0x00100000UL
+#define GUEST_RAM_PAGES		16
+#define GUEST_VIRT		0x40000000UL
+
+#define GUEST_PT_FLAGS		0x3	/* present, writable */
+
+#define MARKER(page)		(0x4a48000000000000UL | (page))
+
+/* x86-64 format, but 4K pages only */
+static struct paging paging_4k[MAX_PAGE_DIR_LEVELS];
+
+X86_64_DEFINE_VIRT2PHYS(test_virt2phys, 4)
+
+static void init_structs(struct paging_structures *pg_structs,
+			 const struct paging *paging)
+{
+	pg_structs->root_paging = paging;
+	pg_structs->root_table = page_alloc(&mem_pool, 1, PAGE_USAGE_CELL_PT);
+	pg_structs->usage = PAGE_USAGE_CELL_PT;
+	pg_structs->budget = NULL;
+	pg_structs->cache = NULL;
+}
+
+static bool page_is_clear(const void *page)
+{
+	const unsigned long *word = page;
+	unsigned int n;
+
+	for (n = 0; n < PAGE_SIZE / sizeof(unsigned long); n++)
+		if (word[n] != 0)
+			return false;
+	return true;
+}
+
+static void test_page_alloc(void)
+{
+	unsigned long used = mem_pool.used_pages;
+	unsigned long largest = page_pool_largest_free(&mem_pool);
+	unsigned long failures = mem_pool.alloc_failures;
+	void *pages[64], *block;
+	unsigned int n;
+
+	for (n = 0; n < 64; n++) {
+		pages[n] = page_alloc(&mem_pool, 1, PAGE_USAGE_OTHER);
+		CHECK(pages[n] != NULL);
+		CHECK(((unsigned long)pages[n] & ~PAGE_MASK) == 0);
+		memset(pages[n], 0xa5, PAGE_SIZE);
+	}
+	CHECK(mem_pool.used_pages == used + 64);
+
+	/* freed pages are scrubbed before they are handed out again */
+	for (n = 0; n < 64; n++)
+		page_free(&mem_pool, pages[n], 1);
+	CHECK(mem_pool.used_pages == used);
+	CHECK(mem_pool.dirty_pages >= 64);
+	for (n = 0; n < 64; n++) {
+		pages[n] = page_alloc(&mem_pool, 1, PAGE_USAGE_OTHER);
+		CHECK(pages[n] != NULL && page_is_clear(pages[n]));
+	}
+
+	/* a hole between used pages is too small for two pages */
+	page_free(&mem_pool, pages[1], 1);
+	block = page_alloc(&mem_pool, 2, PAGE_USAGE_OTHER);
+	CHECK(block != NULL && block != pages[1]);
+	page_free(&mem_pool, block, 2);
+	pages[1] = page_alloc(&mem_pool, 1, PAGE_USAGE_OTHER);
+
+	/* freeing every other page must not merge anything */
+	for (n = 0; n < 64; n += 2)
+		page_free(&mem_pool, pages[n], 1);
+	for (n = 1; n < 64; n += 2)
+		page_free(&mem_pool, pages[n], 1);
+	CHECK(mem_pool.used_pages == used);
+	CHECK(page_pool_largest_free(&mem_pool) == largest);
+
+	block = page_alloc(&mem_pool, 1000, PAGE_USAGE_OTHER);
+	CHECK(block != NULL);
+	CHECK(mem_pool.used_pages == used + 1000);
+	page_free(&mem_pool, block, 1000);
+	CHECK(page_pool_largest_free(&mem_pool) == largest);
+
+	CHECK(page_alloc(&mem_pool, mem_pool.pages, PAGE_USAGE_OTHER) == NULL);
+	CHECK(mem_pool.alloc_failures == failures + 1);
+
+	page_pool_scrub(&mem_pool);
+	CHECK(mem_pool.dirty_pages == 0);
+}
+
+static void test_page_budget(void)
+{
+	unsigned long reserved = mem_pool.reserved_pages;
+	struct page_budget budget = { .strict = true };
+	void *pages;
+
+	CHECK(page_budget_grow(&mem_pool, &budget, 4) == 0);
+	CHECK(mem_pool.reserved_pages == reserved + 4);
+
+	pages = page_budget_alloc(&mem_pool, &budget, 4, PAGE_USAGE_CELL);
+	CHECK(pages != NULL);
+	CHECK(mem_pool.reserved_pages == reserved);
+	CHECK(page_budget_alloc(&mem_pool, &budget, 1, PAGE_USAGE_CELL) ==
+	      NULL);
+
+	page_budget_free(&mem_pool, &budget, pages, 4);
+	CHECK(budget.used == 0);
+	CHECK(mem_pool.reserved_pages == reserved + 4);
+
+	page_budget_shrink(&mem_pool, &budget, 4);
+	CHECK(mem_pool.reserved_pages == reserved);
+
+	CHECK(page_budget_grow(&mem_pool, &budget, mem_pool.pages) ==
+	      -ENOMEM);
+}
+
+static void test_map_huge(void)
+{
+	unsigned long used = mem_pool.used_pages;
+	unsigned long base = 0x80000000UL, size = 0x80000000UL;
+	struct paging_structures pg_structs;
+	unsigned long used_mapped;
+
+	init_structs(&pg_structs, hv_paging);
+
+	CHECK(page_map_create(&pg_structs, base, size, base,
+			      PAGE_DEFAULT_FLAGS, PAGE_MAP_NON_COHERENT) == 0);
+	used_mapped = mem_pool.used_pages;
+	CHECK(page_map_virt2phys(&pg_structs, base) == base);
+	CHECK(page_map_virt2phys(&pg_structs, base + 0x12345678) ==
+	      base + 0x12345678);
+	CHECK(test_virt2phys(pg_structs.root_table, base + 0x12345678) ==
+	      base + 0x12345678);
+	CHECK(page_map_virt2phys(&pg_structs, base + size - 1) ==
+	      base + size - 1);
+	CHECK(page_map_virt2phys(&pg_structs, base - 1) == INVALID_PHYS_ADDR);
+	CHECK(page_map_virt2phys(&pg_structs, base + size) ==
+	      INVALID_PHYS_ADDR);
+
+	/* punching a hole splits the huge pages around it */
+	CHECK(page_map_destroy(&pg_structs, base + 0x201000, PAGE_SIZE,
+			       PAGE_MAP_NON_COHERENT) == 0);
+	CHECK(page_map_virt2phys(&pg_structs, base + 0x201000) ==
+	      INVALID_PHYS_ADDR);
+	CHECK(page_map_virt2phys(&pg_structs, base + 0x200fff) ==
+	      base + 0x200fff);
+	CHECK(page_map_virt2phys(&pg_structs, base + 0x202000) ==
+	      base + 0x202000);
+	CHECK(test_virt2phys(pg_structs.root_table, base + 0x200fff) ==
+	      base + 0x200fff);
+	CHECK(test_virt2phys(pg_structs.root_table, base + 0x201000) ==
+	      INVALID_PHYS_ADDR);
+	CHECK(mem_pool.used_pages > used_mapped);
+
+	/* closing it again coalesces them */
+	CHECK(page_map_create(&pg_structs, base + 0x201000, PAGE_SIZE,
+			      base + 0x201000, PAGE_DEFAULT_FLAGS,
+			      PAGE_MAP_NON_COHERENT) == 0);
+	CHECK(page_map_virt2phys(&pg_structs, base + 0x201234) ==
+	      base + 0x201234);
+	CHECK(mem_pool.used_pages == used_mapped);
+
+	CHECK(page_map_destroy(&pg_structs, base, size,
+			       PAGE_MAP_NON_COHERENT) == 0);
+	CHECK(page_map_virt2phys(&pg_structs, base) == INVALID_PHYS_ADDR);
+	CHECK(mem_pool.used_pages == used + 1);
+
+	page_free(&mem_pool, pg_structs.root_table, 1);
+}
+
+static void test_root_subtable(void)
+{
+	unsigned long used = mem_pool.used_pages;
+	unsigned long virt = 0x8000000000UL;
+	struct page_budget budget = { .strict = true };
+	struct paging_structures pg_structs, sub_structs;
+	struct page_cache cache = { .num = 0 };
+	page_table_t pt;
+
+	init_structs(&pg_structs, hv_paging);
+	pg_structs.budget = &budget;
+	CHECK(page_budget_grow(&mem_pool, &budget, PAGE_CACHE_PAGES + 1) == 0);
+
+	/* the table below a root entry is only created once */
+	pt = page_map_root_subtable(&pg_structs, virt, PAGE_MAP_NON_COHERENT);
+	CHECK(pt != NULL);
+	CHECK(page_map_root_subtable(&pg_structs, virt + 0x40000000UL,
+				     PAGE_MAP_NON_COHERENT) == pt);
+	CHECK(budget.used == 1);
+
+	CHECK(page_cache_fill(&mem_pool, &budget, &cache,
+			      PAGE_USAGE_CELL_PT) == 0);
+	CHECK(cache.num == PAGE_CACHE_PAGES);
+	CHECK(budget.used == PAGE_CACHE_PAGES + 1);
+
+	/* mappings below it take their tables from the cache */
+	sub_structs = pg_structs;
+	sub_structs.root_paging++;
+	sub_structs.root_table = pt;
+	sub_structs.cache = &cache;
+	CHECK(page_map_create(&sub_structs, 0x1000, PAGE_SIZE, virt + 0x1000,
+			      PAGE_DEFAULT_FLAGS, PAGE_MAP_NON_COHERENT) == 0);
+	CHECK(cache.num == PAGE_CACHE_PAGES - 2);
+	CHECK(page_map_virt2phys(&pg_structs, virt + 0x1234) == 0x1234);
+
+	page_cache_drain(&mem_pool, &budget, &cache);
+	CHECK(cache.num == 0);
+	CHECK(budget.used == 3);
+
+	CHECK(page_map_destroy(&pg_structs, virt + 0x1000, PAGE_SIZE,
+			       PAGE_MAP_NON_COHERENT) == 0);
+	CHECK(budget.used == 0);
+	CHECK(mem_pool.used_pages == used + 1);
+
+	page_budget_shrink(&mem_pool, &budget, PAGE_CACHE_PAGES + 1);
+	page_free(&mem_pool, pg_structs.root_table, 1);
+}
+
+static void test_map_4k(void)
+{
+	unsigned long used = mem_pool.used_pages;
+	unsigned long size = 64 * 1024 * 1024;
+	unsigned long virt = 0x7c000000UL;
+	unsigned long phys = 0x100000000UL;
+	struct paging_structures pg_structs;
+	unsigned long offs;
+
+	init_structs(&pg_structs, paging_4k);
+
+	CHECK(page_map_create(&pg_structs, phys, size, virt,
+			      PAGE_DEFAULT_FLAGS, PAGE_MAP_NON_COHERENT) == 0);
+	/* root, PDPT, PD and one table per 2M */
+	CHECK(mem_pool.used_pages == used + 3 + size / 0x200000);
+
+	for (offs = 0; offs < size; offs += 0x1234567 & PAGE_MASK) {
+		CHECK(page_map_virt2phys(&pg_structs, virt + offs) ==
+		      phys + offs);
+		CHECK(test_virt2phys(pg_structs.root_table, virt + offs) ==
+		      phys + offs);
+	}
+
+	/* tables are released as soon as they become empty */
+	CHECK(page_map_destroy(&pg_structs, virt, 0x200000,
+			       PAGE_MAP_NON_COHERENT) == 0);
+	CHECK(mem_pool.used_pages == used + 3 + size / 0x200000 - 1);
+	CHECK(page_map_destroy(&pg_structs, virt, size,
+			       PAGE_MAP_NON_COHERENT) == 0);
+	CHECK(mem_pool.used_pages == used + 1);
+	CHECK(test_virt2phys(pg_structs.root_table, virt) ==
+	      INVALID_PHYS_ADDR);
+
+	page_free(&mem_pool, pg_structs.root_table, 1);
+}
+
+static u64 *guest_page(u8 *ram, unsigned int page)
+{
+	return (u64 *)(ram + page * PAGE_SIZE);
+}
+
+static unsigned long guest_page_gphys(unsigned int page)
+{
+	return GUEST_RAM + page * PAGE_SIZE;
+}
+
+/*
+ * Emulates a cell with GUEST_RAM_PAGES of RAM. Pages 0-3 hold the guest's
+ * x86-64 page tables mapping GUEST_VIRT to pages 8-11, page 4 an alternative
+ * page table mapping to pages 12-15. Page 5 and 6 are an i386 page directory
+ * and table mapping GUEST_VIRT to the same pages.
+ */
+static u8 *guest_setup(void)
+{
+	u8 *ram = page_alloc(&mem_pool, GUEST_RAM_PAGES, PAGE_USAGE_OTHER);
+	u32 *pd32, *pt32;
+	unsigned int n;
+
+	init_structs(&test_gphys_structs, hv_paging);
+	page_map_create(&test_gphys_structs, page_map_hvirt2phys(ram),
+			GUEST_RAM_PAGES * PAGE_SIZE, GUEST_RAM,
+			PAGE_DEFAULT_FLAGS, PAGE_MAP_NON_COHERENT);
+
+	guest_page(ram, 0)[(GUEST_VIRT >> 39) & 0x1ff] =
+		guest_page_gphys(1) | GUEST_PT_FLAGS;
+	guest_page(ram, 1)[(GUEST_VIRT >> 30) & 0x1ff] =
+		guest_page_gphys(2) | GUEST_PT_FLAGS;
+	guest_page(ram, 2)[(GUEST_VIRT >> 21) & 0x1ff] =
+		guest_page_gphys(3) | GUEST_PT_FLAGS;
+	for (n = 0; n < 4; n++) {
+		guest_page(ram, 3)[n] = guest_page_gphys(8 + n) |
+			GUEST_PT_FLAGS;
+		guest_page(ram, 4)[n] = guest_page_gphys(12 + n) |
+			GUEST_PT_FLAGS;
+	}
+
+	pd32 = (u32 *)guest_page(ram, 5);
+	pt32 = (u32 *)guest_page(ram, 6);
+	pd32[GUEST_VIRT >> 22] = guest_page_gphys(6) | GUEST_PT_FLAGS;
+	for (n = 0; n < 4; n++)
+		pt32[n] = guest_page_gphys(8 + n) | GUEST_PT_FLAGS;
+
+	for (n = 8; n < GUEST_RAM_PAGES; n++)
+		guest_page(ram, n)[0] = MARKER(n);
+
+	page_map_guest_tlb_flush(per_cpu(0));
+
+	return ram;
+}
+
+static void guest_cleanup(u8 *ram)
+{
+	page_map_destroy(&test_gphys_structs, GUEST_RAM,
+			 GUEST_RAM_PAGES * PAGE_SIZE, PAGE_MAP_NON_COHERENT);
+	page_free(&mem_pool, test_gphys_structs.root_table, 1);
+	page_free(&mem_pool, ram, GUEST_RAM_PAGES);
+}
+
+static u64 guest_read(const struct guest_paging_structures *pg_structs,
+		      unsigned long virt)
+{
+	u64 *page = page_map_get_guest_page(per_cpu(0), pg_structs, virt,
+					    PAGE_READONLY_FLAGS);
+
+	return page ? *page : 0;
+}
+
+static void test_guest_walk(void)
+{
+	struct guest_paging_structures pg_structs = {
+		.root_paging = x86_64_paging,
+		.root_table_gphys = GUEST_RAM,
+	};
+	struct guest_paging_structures pg_structs32 = {
+		.root_paging = i386_paging,
+		.root_table_gphys = guest_page_gphys(5),
+	};
+	unsigned long used = mem_pool.used_pages;
+	u8 *ram = guest_setup();
+	unsigned int n;
+
+	for (n = 0; n < 4; n++)
+		CHECK(guest_read(&pg_structs, GUEST_VIRT + n * PAGE_SIZE +
+				 0x10) == MARKER(8 + n));
+	/* served from the guest TLB */
+	for (n = 0; n < 4; n++)
+		CHECK(guest_read(&pg_structs, GUEST_VIRT + n * PAGE_SIZE) ==
+		      MARKER(8 + n));
+	CHECK(guest_read(&pg_structs, GUEST_VIRT + 4 * PAGE_SIZE) == 0);
+
+	/* the guest changes its tables without trapping */
+	guest_page(ram, 3)[0] = guest_page_gphys(9) | GUEST_PT_FLAGS;
+	CHECK(guest_read(&pg_structs, GUEST_VIRT) == MARKER(9));
+	guest_page(ram, 2)[(GUEST_VIRT >> 21) & 0x1ff] =
+		guest_page_gphys(4) | GUEST_PT_FLAGS;
+	CHECK(guest_read(&pg_structs, GUEST_VIRT) == MARKER(12));
+	CHECK(guest_read(&pg_structs, GUEST_VIRT + PAGE_SIZE) == MARKER(13));
+	guest_page(ram, 1)[(GUEST_VIRT >> 30) & 0x1ff] = 0;
+	CHECK(guest_read(&pg_structs, GUEST_VIRT) == 0);
+
+	for (n = 0; n < 4; n++)
+		CHECK(guest_read(&pg_structs32, GUEST_VIRT + n * PAGE_SIZE) ==
+		      MARKER(8 + n));
+
+	guest_cleanup(ram);
+	CHECK(mem_pool.used_pages == used);
+}
+
+void test_paging(void)
+{
+	memcpy(paging_4k, x86_64_paging, sizeof(paging_4k));
+	paging_4k[1].page_size = 0;
+	paging_4k[2].page_size = 0;
+
+	test_page_alloc();
+	test_page_budget();
+	test_map_huge();
+	test_root_subtable();
+	test_map_4k();
+	test_guest_walk();
+}
+
+static void bench_page_alloc(void)
+{
+	void *pages[256];
+	unsigned long start;
+	unsigned int n;
+
+	start = BENCH_START();
+	for (n = 0; n < 100000; n++)
+		page_free(&mem_pool, page_alloc(&mem_pool, 1, PAGE_USAGE_OTHER),
+			  1);
+	printk("page_alloc/free, 1 page: %lu cycles\n",
+	       BENCH_END(start) / 100000);
+
+	start = BENCH_START();
+	for (n = 0; n < 100000; n++)
+		page_free(&mem_pool,
+			  page_alloc(&mem_pool, 16, PAGE_USAGE_OTHER), 16);
+	printk("page_alloc/free, 16 pages: %lu cycles\n",
+	       BENCH_END(start) / 100000);
+
+	/* allocate around holes left by every other page */
+	for (n = 0; n < 256; n++)
+		pages[n] = page_alloc(&mem_pool, 1, PAGE_USAGE_OTHER);
+	for (n = 0; n < 256; n += 2)
+		page_free(&mem_pool, pages[n], 1);
+	start = BENCH_START();
+	for (n = 0; n < 100000; n++)
+		page_free(&mem_pool,
+			  page_alloc(&mem_pool, 4, PAGE_USAGE_OTHER), 4);
+	printk("page_alloc/free, 4 pages, fragmented: %lu cycles\n",
+	       BENCH_END(start) / 100000);
+	for (n = 1; n < 256; n += 2)
+		page_free(&mem_pool, pages[n], 1);
+
+	page_pool_scrub(&mem_pool);
+}
+
+static void bench_map(void)
+{
+	unsigned long size = 16UL * 1024 * 1024 * 1024;
+	struct paging_structures pg_structs;
+	unsigned long start;
+
+	init_structs(&pg_structs, paging_4k);
+
+	start = BENCH_START();
+	page_map_create(&pg_structs, 0, size, 0, PAGE_DEFAULT_FLAGS,
+			PAGE_MAP_NON_COHERENT);
+	printk("page_map_create, 16 GiB in 4K pages: %lu cycles\n",
+	       BENCH_END(start));
+
+	start = BENCH_START();
+	page_map_destroy(&pg_structs, 0, size, PAGE_MAP_NON_COHERENT);
+	printk("page_map_destroy, 16 GiB in 4K pages: %lu cycles\n",
+	       BENCH_END(start));
+
+	page_free(&mem_pool, pg_structs.root_table, 1);
+	page_pool_scrub(&mem_pool);
+}
+
+static void bench_virt2phys(void)
+{
+	unsigned long size = 64 * 1024 * 1024, sum = 0;
+	struct paging_structures pg_structs;
+	unsigned long start, n;
+
+	init_structs(&pg_structs, paging_4k);
+	page_map_create(&pg_structs, 0, size, 0, PAGE_DEFAULT_FLAGS,
+			PAGE_MAP_NON_COHERENT);
+
+	start = BENCH_START();
+	for (n = 0; n < 1000000; n++)
+		sum += page_map_virt2phys(&pg_structs,
+					  (n * 0x9e3779b1) % size);
+	printk("page_map_virt2phys, 4 levels: %lu cycles\n",
+	       BENCH_END(start) / 1000000);
+
+	start = BENCH_START();
+	for (n = 0; n < 1000000; n++)
+		sum -= test_virt2phys(pg_structs.root_table,
+				      (n * 0x9e3779b1) % size);
+	printk("X86_64_DEFINE_VIRT2PHYS, 4 levels: %lu cycles\n",
+	       BENCH_END(start) / 1000000);
+
+	CHECK(sum == 0);
+
+	page_map_destroy(&pg_structs, 0, size, PAGE_MAP_NON_COHERENT);
+	page_free(&mem_pool, pg_structs.root_table, 1);
+}
+
+static void bench_guest_walk(void)
+{
+	struct guest_paging_structures pg_structs = {
+		.root_paging = x86_64_paging,
+		.root_table_gphys = GUEST_RAM,
+	};
+	u8 *ram = guest_setup();
+	unsigned long start, n;
+
+	start = BENCH_START();
+	for (n = 0; n < 10000; n++) {
+		page_map_guest_tlb_flush(per_cpu(0));
+		guest_read(&pg_structs, GUEST_VIRT);
+	}
+	printk("page_map_get_guest_page, full walk: %lu cycles\n",
+	       BENCH_END(start) / 10000);
+
+	start = BENCH_START();
+	for (n = 0; n < 10000; n++)
+		guest_read(&pg_structs, GUEST_VIRT);
+	printk("page_map_get_guest_page, guest TLB hit: %lu cycles\n",
+	       BENCH_END(start) / 10000);
+
+	guest_cleanup(ram);
+}
+
+void bench_paging(void)
+{
+	bench_page_alloc();
+	bench_map();
+	bench_virt2phys();
+	bench_guest_walk();
+}
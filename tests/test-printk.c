@@ -0,0 +1,50 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2013
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include <jailhouse/printk.h>
+#include <jailhouse/string.h>
+
+#include "host.h"
+#include "test.h"
+
+#define CHECK_PRINTK(expected, fmt, ...)				\
+	do {								\
+		host_capture_start();					\
+		printk(fmt, ##__VA_ARGS__);				\
+		CHECK(strcmp(host_capture_end(), expected) == 0);	\
+	} while (0)
+
+void test_printk(void)
+{
+	CHECK_PRINTK("plain", "plain");
+	CHECK_PRINTK("line\n\r", "line\n");
+	CHECK_PRINTK("0 -1 2147483647", "%d %d %d", 0, -1, 0x7fffffff);
+	CHECK_PRINTK("-9223372036854775808", "%ld", (long)(1UL << 63));
+	CHECK_PRINTK("4294967295 18446744073709551615", "%u %lu", ~0U, ~0UL);
+	CHECK_PRINTK("0 cafe ffffffff", "%x %x %x", 0, 0xcafe, ~0U);
+	CHECK_PRINTK("123456789abc", "%lx", 0x123456789abcUL);
+	CHECK_PRINTK("0x00000000deadbeef", "%p", (void *)0xdeadbeefUL);
+	CHECK_PRINTK("[   42][00042][ff]", "[%5u][%05d][%2x]", 42, 42, 0xff);
+	CHECK_PRINTK("cell \"linux\"", "cell \"%s\"", "linux");
+}
+
+void bench_printk(void)
+{
+	unsigned long start, n;
+
+	start = BENCH_START();
+	host_capture_start();
+	for (n = 0; n < 10000; n++) {
+		printk("CPU %d, %s: %08lx %p\n", 3, "VM exit", n,
+		       (void *)start);
+		host_capture_start();
+	}
+	host_capture_end();
+	printk("printk, 4 arguments: %lu cycles\n", BENCH_END(start) / 10000);
+}
@@ -0,0 +1,58 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2013
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef _JAILHOUSE_TESTS_TEST_H
+#define _JAILHOUSE_TESTS_TEST_H
+
+#include <jailhouse/paging.h>
+#include <jailhouse/printk.h>
+#include <asm/processor.h>
+
+#define __stringify_1(x)	#x
+#define __stringify(x)		__stringify_1(x)
+
+/* physical address and size of the emulated hypervisor memory */
+#define TEST_HV_PHYS		0x3b000000
+#define TEST_HV_SIZE		0x06000000
+
+#define CHECK(cond)							\
+	do {								\
+		test_checks++;						\
+		if (!(cond)) {						\
+			printk("FAILED: %s:%d: %s\n", __FILE__,		\
+			       __LINE__, #cond);			\
+			test_failures++;				\
+		}							\
+	} while (0)
+
+/* cycles spent in code, excluding the harness's own TLB emulation */
+#define BENCH_START()							\
+	({ test_emulation_cycles = 0; get_cycles(); })
+#define BENCH_END(start)						\
+	(get_cycles() - (start) - test_emulation_cycles)
+
+extern unsigned int test_checks, test_failures;
+
+/* cycles the stubs spent emulating TLB flushes */
+extern unsigned long test_emulation_cycles;
+extern unsigned long test_tlb_flushes;
+
+/* guest-physical to host-physical translation of the emulated cell */
+extern struct paging_structures test_gphys_structs;
+
+void test_paging(void);
+void bench_paging(void);
+
+void test_lib(void);
+void bench_lib(void);
+
+void test_printk(void);
+void bench_printk(void);
+
+#endif /* !_JAILHOUSE_TESTS_TEST_H */
@@ -10,6 +10,7 @@
  * the COPYING file in the top-level directory.
  */
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -30,7 +31,11 @@ static void help(const char *progname)
 	       "   disable\n"
 	       "   cell create CONFIGFILE IMAGE [-l ADDRESS] "
 			"[IMAGE [-l ADDRESS] ...]\n"
-	       "   cell destroy CONFIGFILE\n",
+	       "   cell destroy CONFIGFILE\n"
+	       "   cell start CONFIGFILE [--restore]\n"
+	       "   cell attach CONFIGFILE PHYS VIRT SIZE FLAGS\n"
+	       "   cell detach CONFIGFILE PHYS VIRT SIZE\n"
+	       "   cpu move CPU [CONFIGFILE]\n",
 	       progname);
 }
 
@@ -207,6 +212,114 @@ static int cell_destroy(int argc, char *argv[])
 	return err;
 }
 
+static int cell_start(int argc, char *argv[])
+{
+	struct jailhouse_cell_start cell;
+	size_t size;
+	int err, fd;
+
+	if (argc < 4 || argc > 5 ||
+	    (argc == 5 && strcmp(argv[4], "--restore") != 0)) {
+		help(argv[0]);
+		exit(1);
+	}
+
+	cell.config_address = (unsigned long)read_file(argv[3], &size);
+	cell.config_size = size;
+	cell.flags = argc == 5 ? JAILHOUSE_CELL_RESTORE_IMAGES : 0;
+
+	fd = open_dev();
+
+	err = ioctl(fd, JAILHOUSE_CELL_START, &cell);
+	if (err)
+		perror("JAILHOUSE_CELL_START");
+
+	close(fd);
+	free((void *)(unsigned long)cell.config_address);
+
+	return err;
+}
+
+static unsigned long long parse_number(const char *progname, const char *arg)
+{
+	unsigned long long value;
+	char *endp;
+
+	errno = 0;
+	value = strtoull(arg, &endp, 0);
+	if (errno != 0 || *endp != 0) {
+		help(progname);
+		exit(1);
+	}
+	return value;
+}
+
+static int cell_mem(int argc, char *argv[], bool attach)
+{
+	struct jailhouse_cell_mem cell;
+	size_t size;
+	int err, fd;
+
+	if (argc != (attach ? 8 : 7)) {
+		help(argv[0]);
+		exit(1);
+	}
+
+	memset(&cell, 0, sizeof(cell));
+	cell.region.phys_start = parse_number(argv[0], argv[4]);
+	cell.region.virt_start = parse_number(argv[0], argv[5]);
+	cell.region.size = parse_number(argv[0], argv[6]);
+	if (attach)
+		cell.region.flags = parse_number(argv[0], argv[7]);
+
+	cell.config_address = (unsigned long)read_file(argv[3], &size);
+	cell.config_size = size;
+
+	fd = open_dev();
+
+	err = ioctl(fd, attach ? JAILHOUSE_CELL_MEM_ATTACH :
+		    JAILHOUSE_CELL_MEM_DETACH, &cell);
+	if (err)
+		perror(attach ? "JAILHOUSE_CELL_MEM_ATTACH" :
+		       "JAILHOUSE_CELL_MEM_DETACH");
+
+	close(fd);
+	free((void *)(unsigned long)cell.config_address);
+
+	return err;
+}
+
+static int cpu_move(int argc, char *argv[])
+{
+	struct jailhouse_cpu_move move;
+	size_t size;
+	int err, fd;
+
+	if (argc < 4 || argc > 5 || strcmp(argv[2], "move") != 0) {
+		help(argv[0]);
+		exit(1);
+	}
+
+	memset(&move, 0, sizeof(move));
+	move.cpu = parse_number(argv[0], argv[3]);
+	/* without a cell configuration, the CPU goes back to the root cell */
+	if (argc == 5) {
+		move.config_address = (unsigned long)read_file(argv[4], &size);
+		move.config_size = size;
+	}
+
+	fd = open_dev();
+
+	err = ioctl(fd, JAILHOUSE_CPU_MOVE, &move);
+	if (err)
+		perror("JAILHOUSE_CPU_MOVE");
+
+	close(fd);
+	free((void *)(unsigned long)move.config_address);
+
+	return err;
+}
+
 static int cell_management(int argc, char *argv[])
 {
 	int err;
@@ -220,6 +333,12 @@ static int cell_management(int argc, char *argv[])
 		err = cell_create(argc, argv);
 	else if (strcmp(argv[2], "destroy") == 0)
 		err = cell_destroy(argc, argv);
+	else if (strcmp(argv[2], "start") == 0)
+		err = cell_start(argc, argv);
+	else if (strcmp(argv[2], "attach") == 0)
+		err = cell_mem(argc, argv, true);
+	else if (strcmp(argv[2], "detach") == 0)
+		err = cell_mem(argc, argv, false);
 	else {
 		help(argv[0]);
 		exit(1);
@@ -248,6 +367,8 @@ int main(int argc, char *argv[])
 		close(fd);
 	} else if (strcmp(argv[1], "cell") == 0) {
 		err = cell_management(argc, argv);
+	} else if (strcmp(argv[1], "cpu") == 0) {
+		err = cpu_move(argc, argv);
 	} else {
 		help(argv[0]);
 		exit(1);